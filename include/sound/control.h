@@ -22,6 +22,8 @@
  *
  */
 
+#include <linux/seqlock.h>
+#include <linux/rcupdate.h>
 #include <sound/asound.h>
 
 #define snd_kcontrol_chip(kcontrol) ((kcontrol)->private_data)
@@ -59,8 +61,24 @@ struct snd_kcontrol_volatile {
 	unsigned int access;	/* access rights */
 };
 
+/*
+ * Core-managed copy of the values of a control, see snd_ctl_shadow_init().
+ * Non-volatile elements holding a valid copy are read without calling
+ * the driver's get callback.
+ */
+struct snd_kcontrol_shadow {
+	seqlock_t lock;
+	unsigned int gen;		/* bumped by every update/invalidate */
+	size_t size;			/* bytes of value kept per element */
+	unsigned long *valid;		/* elements with a valid copy */
+	unsigned char *values;		/* size bytes per element */
+};
+
 struct snd_kcontrol {
 	struct list_head list;		/* list of controls */
+	struct hlist_node hash;		/* card->ctl_hash bucket */
+	struct snd_kcontrol_shadow *shadow;	/* optional value copy */
+	struct rcu_head rcu;		/* deferred free for shadow reads */
 	struct snd_ctl_elem_id id;
 	unsigned int count;		/* count of same elements */
 	snd_kcontrol_info_t *info;
@@ -79,13 +97,11 @@ struct snd_kcontrol {
 #define snd_kcontrol(n) list_entry(n, struct snd_kcontrol, list)
 
 struct snd_kctl_event {
-	struct list_head list;	/* list of events */
 	struct snd_ctl_elem_id id;
 	unsigned int mask;
+	unsigned short hnext;	/* next slot + 1 in the numid hash chain */
 };
 
-#define snd_kctl_event(n) list_entry(n, struct snd_kctl_event, list)
-
 struct pid;
 
 struct snd_ctl_file {
@@ -98,7 +114,20 @@ struct snd_ctl_file {
 	spinlock_t read_lock;
 	struct fasync_struct *fasync;
 	int subscribed;			/* read interface is activated */
-	struct list_head events;	/* waiting events for read */
+	struct snd_kctl_event *events;	/* ring of waiting events for read */
+	unsigned short *event_hash;	/* numid -> ring slot + 1, 0 = none */
+	unsigned int event_size;	/* ring size, power of two */
+	unsigned int event_head;	/* slot of the oldest waiting event */
+	unsigned int event_count;	/* number of waiting events */
+	unsigned int event_overrun: 1;	/* events were dropped, ring full */
+	/* SUBSCRIBE_FILTER settings, protected by read_lock */
+	unsigned int filter_ifaces;	/* 1 << iface to report, 0 = all */
+	unsigned int filter_numid_min;
+	unsigned int filter_numid_max;
+	unsigned int filter_events;	/* event mask bits to report */
+	unsigned long event_interval;	/* min jiffies between VALUE wakeups */
+	unsigned long event_last_wake;	/* jiffies of the last wakeup */
+	struct timer_list event_timer;	/* delayed wakeup for VALUE events */
 };
 
 #define snd_ctl_file(n) list_entry(n, struct snd_ctl_file, list)
@@ -116,11 +145,17 @@ int snd_ctl_remove(struct snd_card * card, struct snd_kcontrol * kcontrol);
 int snd_ctl_replace(struct snd_card *card, struct snd_kcontrol *kcontrol, bool add_on_replace);
 int snd_ctl_remove_id(struct snd_card * card, struct snd_ctl_elem_id *id);
 int snd_ctl_rename_id(struct snd_card * card, struct snd_ctl_elem_id *src_id, struct snd_ctl_elem_id *dst_id);
+void snd_ctl_rename(struct snd_card *card, struct snd_kcontrol *kctl, const char *name);
 int snd_ctl_activate_id(struct snd_card *card, struct snd_ctl_elem_id *id,
 			int active);
 struct snd_kcontrol *snd_ctl_find_numid(struct snd_card * card, unsigned int numid);
 struct snd_kcontrol *snd_ctl_find_id(struct snd_card * card, struct snd_ctl_elem_id *id);
 
+int snd_ctl_shadow_init(struct snd_kcontrol *kctl, size_t size);
+void snd_ctl_shadow_update(struct snd_kcontrol *kctl,
+			   struct snd_ctl_elem_value *ucontrol);
+void snd_ctl_shadow_invalidate(struct snd_kcontrol *kctl);
+
 int snd_ctl_create(struct snd_card *card);
 
 int snd_ctl_register_ioctl(snd_kctl_ioctl_func_t fcn);
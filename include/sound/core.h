@@ -25,6 +25,7 @@
 #include <linux/sched.h>		/* wake_up() */
 #include <linux/mutex.h>		/* struct mutex */
 #include <linux/rwsem.h>		/* struct rw_semaphore */
+#include <linux/radix-tree.h>		/* struct radix_tree_root */
 #include <linux/pm.h>			/* pm_message_t */
 #include <linux/stringify.h>
 
@@ -37,6 +38,10 @@
 
 #define CONFIG_SND_MAJOR	116	/* standard configuration */
 
+/* buckets of the per-card control id hash */
+#define SNDRV_CTL_HASH_BITS	8
+#define SNDRV_CTL_HASH_SIZE	(1 << SNDRV_CTL_HASH_BITS)
+
 /* forward declarations */
 struct pci_dev;
 struct module;
@@ -119,6 +124,8 @@ struct snd_card {
 	int controls_count;		/* count of all controls */
 	int user_ctl_count;		/* count of all user controls */
 	struct list_head controls;	/* all controls for this card */
+	struct radix_tree_root ctl_numids;	/* numid -> control */
+	struct hlist_head ctl_hash[SNDRV_CTL_HASH_SIZE]; /* id -> controls */
 	struct list_head ctl_files;	/* active control files */
 
 	struct snd_info_entry *proc_root;	/* root for soundcard specific files */
@@ -78,6 +78,12 @@ struct snd_sg_page {
 	dma_addr_t addr;
 };
 
+/* pages with physically continuous addresses */
+struct snd_sg_run {
+	unsigned int page;	/* first page index */
+	unsigned int pages;	/* number of pages */
+};
+
 struct snd_sg_buf {
 	int size;	/* allocated byte size */
 	int pages;	/* allocated pages */
@@ -85,6 +91,8 @@ struct snd_sg_buf {
 	struct snd_sg_page *table;	/* address table */
 	struct page **page_table;	/* page table (for vmap/vunmap) */
 	struct device *dev;
+	unsigned int runs;		/* number of continuous runs */
+	struct snd_sg_run *run_table;	/* runs sorted by page, or NULL */
 };
 
 /*
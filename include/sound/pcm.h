@@ -30,6 +30,7 @@
 #include <linux/mm.h>
 #include <linux/bitops.h>
 #include <linux/pm_qos.h>
+#include <linux/hrtimer.h>
 
 #define snd_pcm_substream_chip(substream) ((substream)->private_data)
 #define snd_pcm_chip(pcm) ((pcm)->private_data)
@@ -221,6 +222,7 @@ struct snd_pcm_hw_rule {
 	snd_pcm_hw_rule_func_t func;
 	int var;
 	int deps[4];
+	unsigned int dep_mask;		/* deps as a bitmask of params */
 	void *private;
 };
 
@@ -232,6 +234,8 @@ struct snd_pcm_hw_constraints {
 	unsigned int rules_num;
 	unsigned int rules_all;
 	struct snd_pcm_hw_rule *rules;
+	/* for each param, the bitmap of rules depending on it */
+	unsigned long *dependents;
 };
 
 static inline struct snd_mask *constrs_mask(struct snd_pcm_hw_constraints *constrs,
@@ -246,6 +250,12 @@ static inline struct snd_interval *constrs_interval(struct snd_pcm_hw_constraint
 	return &constrs->intervals[var - SNDRV_PCM_HW_PARAM_FIRST_INTERVAL];
 }
 
+static inline unsigned long *constrs_dependents(struct snd_pcm_hw_constraints *constrs,
+						snd_pcm_hw_param_t var)
+{
+	return constrs->dependents + var * BITS_TO_LONGS(constrs->rules_all);
+}
+
 struct snd_ratnum {
 	unsigned int num;
 	unsigned int den_min, den_max, den_step;
@@ -273,6 +283,7 @@ struct snd_pcm_hw_constraint_list {
 };
 
 struct snd_pcm_hwptr_log;
+struct snd_pcm_trace;
 
 struct snd_pcm_runtime {
 	/* -- Status -- */
@@ -284,6 +295,9 @@ struct snd_pcm_runtime {
 	snd_pcm_uframes_t hw_ptr_interrupt; /* Position at interrupt time */
 	unsigned long hw_ptr_jiffies;	/* Time when hw_ptr is updated */
 	unsigned long hw_ptr_buffer_jiffies; /* buffer time in jiffies */
+	u64 hw_ptr_ns;			/* time of the last hw_ptr change (timer wakeup, PCM timer) */
+	u64 frame_ns_mult;		/* ns per frame, 32.32 fixed point */
+	u64 frame_jiffies_mult;		/* jiffies per frame, 32.32 fixed point */
 	snd_pcm_sframes_t delay;	/* extra delay; typically FIFO size */
 	u64 hw_ptr_wrap;                /* offset for hw_ptr due to boundary wrap-around */
 
@@ -304,6 +318,7 @@ struct snd_pcm_runtime {
 	unsigned int rate_num;
 	unsigned int rate_den;
 	unsigned int no_period_wakeup: 1;
+	unsigned int timer_wakeup: 1;	/* wake sleepers by hrtimer at avail_min */
 
 	/* -- SW params -- */
 	int tstamp_mode;		/* mmap timestamp is updated */
@@ -344,6 +359,9 @@ struct snd_pcm_runtime {
 
 	/* -- timer -- */
 	unsigned int timer_resolution;	/* timer resolution */
+	unsigned int timer_sub_resolution; /* interpolated timer resolution */
+	unsigned int timer_subticks;	/* interpolated ticks per period */
+	unsigned int timer_subtick;	/* ticks delivered in this period */
 	int tstamp_type;		/* timestamp type */
 
 	/* -- DMA -- */           
@@ -371,6 +389,42 @@ struct snd_pcm_group {		/* keep linked substreams */
 
 struct pid;
 
+#ifdef CONFIG_SND_VERBOSE_PROCFS
+/* latency histograms, see snd_pcm_period_elapsed() and wait_for_avail() */
+enum {
+	SND_PCM_LAT_IRQ_HWPTR,		/* period_elapsed() -> hw_ptr updated */
+	SND_PCM_LAT_HWPTR_WAKEUP,	/* hw_ptr updated -> blocked task runs */
+	SND_PCM_LAT_WAKEUP_XFER,	/* task runs -> appl_ptr updated */
+	SND_PCM_LAT_NUM
+};
+
+#define SND_PCM_LAT_BUCKETS	24	/* log2 usecs, the last one is open */
+
+/* updated under the stream lock */
+struct snd_pcm_latency {
+	unsigned int enabled: 1;
+	u64 hw_ptr_ns;			/* last hw_ptr update from the irq */
+	u64 wakeup_ns;			/* pending wakeup of a transfer, 0 = none */
+	u32 hist[SND_PCM_LAT_NUM][SND_PCM_LAT_BUCKETS];
+};
+
+/* driver callbacks accounted in substream->cb_stats */
+enum {
+	SND_PCM_CB_POINTER,
+	SND_PCM_CB_TRIGGER,
+	SND_PCM_CB_COPY,
+	SND_PCM_CB_SILENCE,
+	SND_PCM_CB_PREPARE,
+	SND_PCM_CB_NUM
+};
+
+struct snd_pcm_cb_stat {
+	u64 count;
+	u64 total_ns;
+	u64 max_ns;
+};
+#endif
+
 struct snd_pcm_substream {
 	struct snd_pcm *pcm;
 	struct snd_pcm_str *pstr;
@@ -390,6 +444,10 @@ struct snd_pcm_substream {
         /* -- timer section -- */
 	struct snd_timer *timer;		/* timer */
 	unsigned timer_running: 1;	/* time is running */
+	struct snd_timer *timer_sub;	/* interpolated timer */
+	unsigned timer_sub_running: 1;	/* interpolated timer is running */
+	struct hrtimer wakeup_timer;	/* timer wakeup mode */
+	struct hrtimer timer_interp;	/* sub-period timer ticks */
 	/* -- next substream -- */
 	struct snd_pcm_substream *next;
 	/* -- linked substreams -- */
@@ -415,6 +473,15 @@ struct snd_pcm_substream {
 	struct snd_info_entry *proc_status_entry;
 	struct snd_info_entry *proc_prealloc_entry;
 	struct snd_info_entry *proc_prealloc_max_entry;
+	struct snd_info_entry *proc_trace_entry;
+	struct snd_info_entry *proc_trace_size_entry;
+	struct snd_pcm_trace *trace;	/* hw_ptr trace ring, NULL = disabled */
+	struct mutex trace_mutex;	/* protects resizing against readers */
+	struct snd_info_entry *proc_latency_entry;
+	struct snd_pcm_latency latency;
+	struct snd_info_entry *proc_callbacks_entry;
+	unsigned int cb_stats_enabled;
+	struct snd_pcm_cb_stat cb_stats[SND_PCM_CB_NUM];
 #endif
 	/* misc flags */
 	unsigned int hw_opened: 1;
@@ -422,6 +489,18 @@ struct snd_pcm_substream {
 
 #define SUBSTREAM_BUSY(substream) ((substream)->ref_count > 0)
 
+#ifdef CONFIG_SND_VERBOSE_PROCFS
+/*
+ * hw_ptr trace ring; written under the stream lock, read without it by
+ * validating the sequence number of each entry
+ */
+struct snd_pcm_trace {
+	unsigned int size;		/* number of entries, power of two */
+	u64 head;			/* sequence number of the next entry */
+	struct snd_pcm_trace_entry entries[0];
+};
+#endif
+
 
 struct snd_pcm_str {
 	int stream;				/* stream (direction) */
@@ -577,6 +656,96 @@ do { \
 #define snd_pcm_group_for_each_entry(s, substream) \
 	list_for_each_entry(s, &substream->group->substreams, link_list)
 
+/*
+ * accounting of the time spent in the driver callbacks; the counters
+ * of the callbacks called without the stream lock may miss an update
+ * when they race, which is fine for statistics
+ */
+#ifdef CONFIG_SND_VERBOSE_PROCFS
+static inline u64 snd_pcm_cb_begin(struct snd_pcm_substream *substream)
+{
+	if (likely(!substream->cb_stats_enabled))
+		return 0;
+	return ktime_to_ns(ktime_get());
+}
+
+static inline void snd_pcm_cb_end(struct snd_pcm_substream *substream,
+				  unsigned int type, u64 start)
+{
+	struct snd_pcm_cb_stat *stat = &substream->cb_stats[type];
+	u64 ns;
+
+	if (likely(!start))
+		return;
+	ns = ktime_to_ns(ktime_get()) - start;
+	stat->count++;
+	stat->total_ns += ns;
+	if (ns > stat->max_ns)
+		stat->max_ns = ns;
+}
+#else
+static inline u64 snd_pcm_cb_begin(struct snd_pcm_substream *substream)
+{
+	return 0;
+}
+
+static inline void snd_pcm_cb_end(struct snd_pcm_substream *substream,
+				  unsigned int type, u64 start)
+{
+}
+#endif
+
+static inline int snd_pcm_ops_prepare(struct snd_pcm_substream *substream)
+{
+	u64 start = snd_pcm_cb_begin(substream);
+	int err = substream->ops->prepare(substream);
+
+	snd_pcm_cb_end(substream, SND_PCM_CB_PREPARE, start);
+	return err;
+}
+
+static inline int snd_pcm_ops_trigger(struct snd_pcm_substream *substream,
+				      int cmd)
+{
+	u64 start = snd_pcm_cb_begin(substream);
+	int err = substream->ops->trigger(substream, cmd);
+
+	snd_pcm_cb_end(substream, SND_PCM_CB_TRIGGER, start);
+	return err;
+}
+
+static inline snd_pcm_uframes_t
+snd_pcm_ops_pointer(struct snd_pcm_substream *substream)
+{
+	u64 start = snd_pcm_cb_begin(substream);
+	snd_pcm_uframes_t pos = substream->ops->pointer(substream);
+
+	snd_pcm_cb_end(substream, SND_PCM_CB_POINTER, start);
+	return pos;
+}
+
+static inline int snd_pcm_ops_copy(struct snd_pcm_substream *substream,
+				   int channel, snd_pcm_uframes_t pos,
+				   void __user *buf, snd_pcm_uframes_t count)
+{
+	u64 start = snd_pcm_cb_begin(substream);
+	int err = substream->ops->copy(substream, channel, pos, buf, count);
+
+	snd_pcm_cb_end(substream, SND_PCM_CB_COPY, start);
+	return err;
+}
+
+static inline int snd_pcm_ops_silence(struct snd_pcm_substream *substream,
+				      int channel, snd_pcm_uframes_t pos,
+				      snd_pcm_uframes_t count)
+{
+	u64 start = snd_pcm_cb_begin(substream);
+	int err = substream->ops->silence(substream, channel, pos, count);
+
+	snd_pcm_cb_end(substream, SND_PCM_CB_SILENCE, start);
+	return err;
+}
+
 static inline int snd_pcm_running(struct snd_pcm_substream *substream)
 {
 	return (substream->runtime->status->state == SNDRV_PCM_STATE_RUNNING ||
@@ -584,6 +753,40 @@ static inline int snd_pcm_running(struct snd_pcm_substream *substream)
 		 substream->stream == SNDRV_PCM_STREAM_PLAYBACK));
 }
 
+/*
+ * sequence count around the hw_ptr/tstamp updates of the mmap status;
+ * writers must hold the stream lock
+ */
+static inline void snd_pcm_status_write_begin(struct snd_pcm_runtime *runtime)
+{
+	runtime->status->seq++;
+	smp_wmb();
+}
+
+static inline void snd_pcm_status_write_end(struct snd_pcm_runtime *runtime)
+{
+	smp_wmb();
+	runtime->status->seq++;
+}
+
+static inline unsigned int
+snd_pcm_status_read_begin(struct snd_pcm_runtime *runtime)
+{
+	unsigned int seq;
+
+	while ((seq = ACCESS_ONCE(runtime->status->seq)) & 1)
+		cpu_relax();
+	smp_rmb();
+	return seq;
+}
+
+static inline int snd_pcm_status_read_retry(struct snd_pcm_runtime *runtime,
+					    unsigned int seq)
+{
+	smp_rmb();
+	return ACCESS_ONCE(runtime->status->seq) != seq;
+}
+
 static inline ssize_t bytes_to_samples(struct snd_pcm_runtime *runtime, ssize_t size)
 {
 	return size * 8 / runtime->sample_bits;
@@ -880,6 +1083,8 @@ int snd_pcm_lib_ioctl(struct snd_pcm_substream *substream,
 int snd_pcm_update_state(struct snd_pcm_substream *substream,
 			 struct snd_pcm_runtime *runtime);
 int snd_pcm_update_hw_ptr(struct snd_pcm_substream *substream);
+void snd_pcm_wakeup_timer_arm(struct snd_pcm_substream *substream);
+enum hrtimer_restart snd_pcm_wakeup_timer_func(struct hrtimer *timer);
 int snd_pcm_playback_xrun_check(struct snd_pcm_substream *substream);
 int snd_pcm_capture_xrun_check(struct snd_pcm_substream *substream);
 int snd_pcm_playback_xrun_asap(struct snd_pcm_substream *substream);
@@ -895,6 +1100,12 @@ snd_pcm_sframes_t snd_pcm_lib_writev(struct snd_pcm_substream *substream,
 				     void __user **bufs, snd_pcm_uframes_t frames);
 snd_pcm_sframes_t snd_pcm_lib_readv(struct snd_pcm_substream *substream,
 				    void __user **bufs, snd_pcm_uframes_t frames);
+snd_pcm_sframes_t __snd_pcm_lib_write(struct snd_pcm_substream *substream,
+				      const void __user *buf,
+				      snd_pcm_uframes_t frames, int hwsync);
+snd_pcm_sframes_t __snd_pcm_lib_read(struct snd_pcm_substream *substream,
+				     void __user *buf, snd_pcm_uframes_t frames,
+				     int hwsync);
 
 extern const struct snd_pcm_hw_constraint_list snd_pcm_known_rates;
 
@@ -926,6 +1137,10 @@ static inline void snd_pcm_set_runtime_buffer(struct snd_pcm_substream *substrea
 void snd_pcm_timer_resolution_change(struct snd_pcm_substream *substream);
 void snd_pcm_timer_init(struct snd_pcm_substream *substream);
 void snd_pcm_timer_done(struct snd_pcm_substream *substream);
+void snd_pcm_timer_notify(struct snd_pcm_substream *substream, int event);
+void snd_pcm_timer_period_elapsed(struct snd_pcm_substream *substream);
+void snd_pcm_timer_resync(struct snd_pcm_substream *substream);
+enum hrtimer_restart snd_pcm_timer_interp_func(struct hrtimer *timer);
 
 static inline void snd_pcm_gettime(struct snd_pcm_runtime *runtime,
 				   struct timespec *tv)
@@ -950,6 +1165,8 @@ int snd_pcm_lib_preallocate_pages_for_all(struct snd_pcm *pcm,
 					  size_t size, size_t max);
 int snd_pcm_lib_malloc_pages(struct snd_pcm_substream *substream, size_t size);
 int snd_pcm_lib_free_pages(struct snd_pcm_substream *substream);
+void snd_pcm_dma_pool_init(void);	/* for the PCM core */
+void snd_pcm_dma_pool_done(void);
 
 int _snd_pcm_lib_alloc_vmalloc_buffer(struct snd_pcm_substream *substream,
 				      size_t size, gfp_t gfp_flags);
@@ -110,6 +110,11 @@ struct snd_timer_instance {
 	unsigned long pticks;		/* accumulated ticks for callback */
 	unsigned long resolution;	/* current resolution for tasklet */
 	unsigned long lost;		/* lost ticks */
+	unsigned long callbacks;	/* number of delivered callbacks */
+	unsigned long missed;		/* expirations merged into a callback */
+	unsigned long lat_max;		/* max. callback latency in ns */
+	u64 lat_total;			/* sum of callback latencies in ns */
+	ktime_t tstamp;			/* when the callback was queued */
 	int slave_class;
 	unsigned int slave_id;
 	struct list_head open_list;
@@ -136,7 +136,7 @@ struct snd_hwdep_dsp_image {
  *                                                                           *
  *****************************************************************************/
 
-#define SNDRV_PCM_VERSION		SNDRV_PROTOCOL_VERSION(2, 0, 11)
+#define SNDRV_PCM_VERSION		SNDRV_PROTOCOL_VERSION(2, 0, 14)
 
 typedef unsigned long snd_pcm_uframes_t;
 typedef signed long snd_pcm_sframes_t;
@@ -338,6 +338,7 @@ typedef int snd_pcm_hw_param_t;
 #define SNDRV_PCM_HW_PARAMS_NORESAMPLE	(1<<0)	/* avoid rate resampling */
 #define SNDRV_PCM_HW_PARAMS_EXPORT_BUFFER	(1<<1)	/* export buffer */
 #define SNDRV_PCM_HW_PARAMS_NO_PERIOD_WAKEUP	(1<<2)	/* disable period wakeups */
+#define SNDRV_PCM_HW_PARAMS_TIMER_WAKEUP	(1<<3)	/* wake up at avail_min by timer */
 
 struct snd_interval {
 	unsigned int min, max;
@@ -414,9 +415,18 @@ struct snd_pcm_status {
 	unsigned char reserved[56-sizeof(struct timespec)]; /* must be filled with zero */
 };
 
+/*
+ * hw_ptr, tstamp and audio_tstamp are published with a sequence count
+ * (protocol 2.0.14 and later): seq is odd while the kernel updates them.
+ * An mmap reader samples seq, waits for it to be even, reads the fields
+ * and retries if seq has changed meanwhile.
+ */
 struct snd_pcm_mmap_status {
 	snd_pcm_state_t state;		/* RO: state - SNDRV_PCM_STATE_XXXX */
-	int pad1;			/* Needed for 64 bit alignment */
+	union {
+		int pad1;		/* Needed for 64 bit alignment */
+		unsigned int seq;	/* RO: update sequence count */
+	};
 	snd_pcm_uframes_t hw_ptr;	/* RO: hw ptr (0...boundary-1) */
 	struct timespec tstamp;		/* Timestamp */
 	snd_pcm_state_t suspended_state; /* RO: suspended stream state */
@@ -456,6 +466,42 @@ struct snd_xfern {
 	snd_pcm_uframes_t frames;
 };
 
+/* one transfer of a WRITEI_MULTI/READI_MULTI request */
+struct snd_xferi_vec {
+	snd_pcm_sframes_t result;	/* transferred frames or -errno */
+	void __user *buf;
+	snd_pcm_uframes_t frames;
+	int fd;				/* PCM file linked with the ioctl file */
+	unsigned int reserved;
+};
+
+struct snd_xferi_multi {
+	unsigned int count;		/* number of entries in vec */
+	unsigned int reserved;
+	struct snd_xferi_vec __user *vec;
+};
+
+/* records of /proc/asound/cardX/pcmYD/subZ/trace */
+enum {
+	SNDRV_PCM_TRACE_HWPTR = 0,	/* hw_ptr update outside of an interrupt */
+	SNDRV_PCM_TRACE_PERIOD,		/* hw_ptr update from period_elapsed */
+	SNDRV_PCM_TRACE_BADPOS,		/* pointer callback out of range */
+	SNDRV_PCM_TRACE_BADDELTA,	/* unexpected hw_ptr jump, ignored */
+	SNDRV_PCM_TRACE_XRUN,		/* stream stopped by an xrun */
+	SNDRV_PCM_TRACE_LAST = SNDRV_PCM_TRACE_XRUN,
+};
+
+struct snd_pcm_trace_entry {
+	__u64 seq;			/* sequence number, gaps = lost records */
+	__u64 tstamp_ns;		/* CLOCK_MONOTONIC */
+	__u64 pos;			/* pointer callback result */
+	__u64 hw_ptr;			/* hw ptr after the update */
+	__u64 appl_ptr;			/* appl ptr */
+	__u64 avail;			/* frames available after the update */
+	__u32 reason;			/* SNDRV_PCM_TRACE_XXX */
+	__u32 in_interrupt;		/* non-zero if called from period_elapsed */
+};
+
 enum {
 	SNDRV_PCM_TSTAMP_TYPE_GETTIMEOFDAY = 0,	/* gettimeofday equivalent */
 	SNDRV_PCM_TSTAMP_TYPE_MONOTONIC,	/* posix_clock_monotonic equivalent */
@@ -538,6 +584,8 @@ enum {
 #define SNDRV_PCM_IOCTL_READI_FRAMES	_IOR('A', 0x51, struct snd_xferi)
 #define SNDRV_PCM_IOCTL_WRITEN_FRAMES	_IOW('A', 0x52, struct snd_xfern)
 #define SNDRV_PCM_IOCTL_READN_FRAMES	_IOR('A', 0x53, struct snd_xfern)
+#define SNDRV_PCM_IOCTL_WRITEI_MULTI	_IOW('A', 0x54, struct snd_xferi_multi)
+#define SNDRV_PCM_IOCTL_READI_MULTI	_IOR('A', 0x55, struct snd_xferi_multi)
 #define SNDRV_PCM_IOCTL_LINK		_IOW('A', 0x60, int)
 #define SNDRV_PCM_IOCTL_UNLINK		_IO('A', 0x61)
 
@@ -604,7 +652,7 @@ struct snd_rawmidi_status {
  *  Timer section - /dev/snd/timer
  */
 
-#define SNDRV_TIMER_VERSION		SNDRV_PROTOCOL_VERSION(2, 0, 6)
+#define SNDRV_TIMER_VERSION		SNDRV_PROTOCOL_VERSION(2, 0, 7)
 
 enum {
 	SNDRV_TIMER_CLASS_NONE = -1,
@@ -630,6 +678,9 @@ enum {
 #define SNDRV_TIMER_GLOBAL_HPET		2
 #define SNDRV_TIMER_GLOBAL_HRTIMER	3
 
+/* PCM timers (subdevice member): (substream << 1) | stream */
+#define SNDRV_TIMER_PCM_INTERP		(1<<16)	/* ticks interpolated between periods */
+
 /* info flags */
 #define SNDRV_TIMER_FLG_SLAVE		(1<<0)	/* cannot be controlled */
 
@@ -717,6 +768,7 @@ struct snd_timer_status {
 #define SNDRV_TIMER_IOCTL_INFO		_IOR('T', 0x11, struct snd_timer_info)
 #define SNDRV_TIMER_IOCTL_PARAMS	_IOW('T', 0x12, struct snd_timer_params)
 #define SNDRV_TIMER_IOCTL_STATUS	_IOR('T', 0x14, struct snd_timer_status)
+#define SNDRV_TIMER_IOCTL_QUEUE_PARAMS	_IOW('T', 0x15, struct snd_timer_queue_params)
 /* The following four ioctls are changed since 1.0.9 due to confliction */
 #define SNDRV_TIMER_IOCTL_START		_IO('T', 0xa0)
 #define SNDRV_TIMER_IOCTL_STOP		_IO('T', 0xa1)
@@ -728,6 +780,28 @@ struct snd_timer_read {
 	unsigned int ticks;
 };
 
+/* wakeup coalescing for the read queue */
+struct snd_timer_queue_params {
+	unsigned int avail_min;		/* wake up after this many interrupts or events */
+	unsigned int max_delay_us;	/* ... or the oldest one waits this long, 0 = no limit */
+	unsigned char reserved[56];
+};
+
+/*
+ * Header of the read queue as seen through mmap() of the timer device;
+ * the records (snd_timer_read or snd_timer_tread) follow it.  Records
+ * head..tail-1 (free-running, modulo size) are valid; the reader
+ * advances head when done with them.
+ */
+struct snd_timer_mmap_queue {
+	unsigned int head;		/* RW: records consumed */
+	unsigned int tail;		/* RO: records produced */
+	unsigned int size;		/* RO: ring slots, power of two */
+	unsigned int tread;		/* RO: records are struct snd_timer_tread */
+	unsigned int overrun;		/* RO: records lost, queue full */
+	unsigned char reserved[44];
+};
+
 enum {
 	SNDRV_TIMER_EVENT_RESOLUTION = 0,	/* val = resolution in ns */
 	SNDRV_TIMER_EVENT_TICK,			/* val = ticks */
@@ -759,7 +833,7 @@ struct snd_timer_tread {
  *                                                                          *
  ****************************************************************************/
 
-#define SNDRV_CTL_VERSION		SNDRV_PROTOCOL_VERSION(2, 0, 7)
+#define SNDRV_CTL_VERSION		SNDRV_PROTOCOL_VERSION(2, 0, 10)
 
 struct snd_ctl_card_info {
 	int card;			/* card number */
@@ -896,6 +970,22 @@ struct snd_ctl_elem_value {
 	unsigned char reserved[128-sizeof(struct timespec)];
 };
 
+struct snd_ctl_elem_values {
+	unsigned int count;		/* W: count of values */
+	unsigned int done;		/* R: count of values processed */
+	struct snd_ctl_elem_value __user *pvalues; /* RW: values */
+	unsigned char reserved[48];
+};
+
+struct snd_ctl_event_filter {
+	unsigned int iface_mask;	/* W: 1 << SNDRV_CTL_ELEM_IFACE_*, 0 = all */
+	unsigned int numid_min;		/* W: first numid to report */
+	unsigned int numid_max;		/* W: last numid to report, 0 = no limit */
+	unsigned int event_mask;	/* W: SNDRV_CTL_EVENT_MASK_* to report, 0 = all */
+	unsigned int min_interval_ms;	/* W: min time between wakeups for VALUE events */
+	unsigned char reserved[44];
+};
+
 struct snd_ctl_tlv {
 	unsigned int numid;	/* control element numeric identification */
 	unsigned int length;	/* in bytes aligned to 4 */
@@ -917,6 +1007,9 @@ struct snd_ctl_tlv {
 #define SNDRV_CTL_IOCTL_TLV_READ	_IOWR('U', 0x1a, struct snd_ctl_tlv)
 #define SNDRV_CTL_IOCTL_TLV_WRITE	_IOWR('U', 0x1b, struct snd_ctl_tlv)
 #define SNDRV_CTL_IOCTL_TLV_COMMAND	_IOWR('U', 0x1c, struct snd_ctl_tlv)
+#define SNDRV_CTL_IOCTL_ELEM_READ_MULTI	_IOWR('U', 0x1d, struct snd_ctl_elem_values)
+#define SNDRV_CTL_IOCTL_ELEM_WRITE_MULTI _IOWR('U', 0x1e, struct snd_ctl_elem_values)
+#define SNDRV_CTL_IOCTL_SUBSCRIBE_FILTER _IOW('U', 0x1f, struct snd_ctl_event_filter)
 #define SNDRV_CTL_IOCTL_HWDEP_NEXT_DEVICE _IOWR('U', 0x20, int)
 #define SNDRV_CTL_IOCTL_HWDEP_INFO	_IOR('U', 0x21, struct snd_hwdep_info)
 #define SNDRV_CTL_IOCTL_PCM_NEXT_DEVICE	_IOR('U', 0x30, int)
@@ -934,7 +1027,8 @@ struct snd_ctl_tlv {
 
 enum sndrv_ctl_event_type {
 	SNDRV_CTL_EVENT_ELEM = 0,
-	SNDRV_CTL_EVENT_LAST = SNDRV_CTL_EVENT_ELEM,
+	SNDRV_CTL_EVENT_OVERRUN,	/* events were lost, re-read all elements */
+	SNDRV_CTL_EVENT_LAST = SNDRV_CTL_EVENT_OVERRUN,
 };
 
 #define SNDRV_CTL_EVENT_MASK_VALUE	(1<<0)	/* element value was changed */
@@ -23,6 +23,9 @@
 #include <linux/interrupt.h>
 #include <linux/module.h>
 #include <linux/slab.h>
+#include <linux/log2.h>
+#include <linux/hash.h>
+#include <linux/dcache.h>
 #include <linux/vmalloc.h>
 #include <linux/time.h>
 #include <sound/core.h>
@@ -33,6 +36,13 @@
 /* max number of user-defined controls */
 #define MAX_USER_CONTROLS	32
 #define MAX_CONTROL_COUNT	1028
+/* values copied in per step of ELEM_READ_MULTI / ELEM_WRITE_MULTI */
+#define SND_CTL_ELEM_MULTI_CHUNK	16
+
+/* per-file event ring, sized from the card's numid space at subscribe */
+#define SND_CTL_EVENT_RING_MIN	64
+#define SND_CTL_EVENT_RING_MAX	16384
+#define SND_CTL_EVENT_RING_SLACK	32
 
 struct snd_kctl_ioctl {
 	struct list_head list;		/* list of all ioctls */
@@ -45,6 +55,8 @@ static LIST_HEAD(snd_control_ioctls);
 static LIST_HEAD(snd_control_compat_ioctls);
 #endif
 
+static void snd_ctl_event_timer(unsigned long data);
+
 static int snd_ctl_open(struct inode *inode, struct file *file)
 {
 	unsigned long flags;
@@ -75,9 +87,12 @@ static int snd_ctl_open(struct inode *inode, struct file *file)
 		err = -ENOMEM;
 		goto __error;
 	}
-	INIT_LIST_HEAD(&ctl->events);
 	init_waitqueue_head(&ctl->change_sleep);
 	spin_lock_init(&ctl->read_lock);
+	ctl->filter_numid_max = UINT_MAX;
+	ctl->filter_events = ~0U;
+	setup_timer(&ctl->event_timer, snd_ctl_event_timer,
+		    (unsigned long)ctl);
 	ctl->card = card;
 	ctl->prefer_pcm_subdevice = -1;
 	ctl->prefer_rawmidi_subdevice = -1;
@@ -99,18 +114,117 @@ static int snd_ctl_open(struct inode *inode, struct file *file)
       	return err;
 }
 
+/*
+ * Waiting events are kept in a fixed ring allocated when the file
+ * subscribes, so that snd_ctl_notify() never allocates memory from
+ * atomic context.  Events for the same numid are coalesced through a
+ * small hash whose buckets and chains hold ring slot + 1.  When the
+ * ring is full, the event is dropped and the reader gets a single
+ * SNDRV_CTL_EVENT_OVERRUN to tell it to re-read all elements.
+ */
+static int snd_ctl_alloc_read_queue(struct snd_ctl_file *ctl)
+{
+	unsigned long flags;
+	struct snd_kctl_event *events;
+	unsigned short *hash;
+	unsigned int size;
+
+	size = ctl->card->last_numid + SND_CTL_EVENT_RING_SLACK;
+	size = clamp_t(unsigned int, size, SND_CTL_EVENT_RING_MIN,
+		       SND_CTL_EVENT_RING_MAX);
+	size = roundup_pow_of_two(size);
+	events = vzalloc(size * sizeof(*events));
+	if (!events)
+		return -ENOMEM;
+	hash = kcalloc(size, sizeof(*hash), GFP_KERNEL);
+	if (!hash) {
+		vfree(events);
+		return -ENOMEM;
+	}
+	spin_lock_irqsave(&ctl->read_lock, flags);
+	if (ctl->events) {
+		/* lost a race with a concurrent subscribe */
+		spin_unlock_irqrestore(&ctl->read_lock, flags);
+		vfree(events);
+		kfree(hash);
+		return 0;
+	}
+	ctl->events = events;
+	ctl->event_hash = hash;
+	ctl->event_size = size;
+	ctl->event_head = 0;
+	ctl->event_count = 0;
+	ctl->event_overrun = 0;
+	spin_unlock_irqrestore(&ctl->read_lock, flags);
+	return 0;
+}
+
 static void snd_ctl_empty_read_queue(struct snd_ctl_file * ctl)
 {
 	unsigned long flags;
-	struct snd_kctl_event *cread;
+	struct snd_kctl_event *events;
+	unsigned short *hash;
 	
 	spin_lock_irqsave(&ctl->read_lock, flags);
-	while (!list_empty(&ctl->events)) {
-		cread = snd_kctl_event(ctl->events.next);
-		list_del(&cread->list);
-		kfree(cread);
-	}
+	events = ctl->events;
+	hash = ctl->event_hash;
+	ctl->events = NULL;
+	ctl->event_hash = NULL;
+	ctl->event_size = 0;
+	ctl->event_count = 0;
+	ctl->event_overrun = 0;
 	spin_unlock_irqrestore(&ctl->read_lock, flags);
+	vfree(events);
+	kfree(hash);
+}
+
+/* the caller must hold ctl->read_lock */
+static void snd_ctl_queue_event(struct snd_ctl_file *ctl, unsigned int mask,
+				struct snd_ctl_elem_id *id)
+{
+	unsigned short *bucket;
+	struct snd_kctl_event *ev;
+	unsigned int slot;
+
+	if (!ctl->events)
+		return;
+	bucket = &ctl->event_hash[id->numid & (ctl->event_size - 1)];
+	for (slot = *bucket; slot; slot = ev->hnext) {
+		ev = &ctl->events[slot - 1];
+		if (ev->id.numid == id->numid) {
+			ev->mask |= mask;
+			return;
+		}
+	}
+	if (ctl->event_count >= ctl->event_size) {
+		ctl->event_overrun = 1;
+		return;
+	}
+	slot = (ctl->event_head + ctl->event_count) & (ctl->event_size - 1);
+	ev = &ctl->events[slot];
+	ev->id = *id;
+	ev->mask = mask;
+	ev->hnext = *bucket;
+	*bucket = slot + 1;
+	ctl->event_count++;
+}
+
+/* the caller must hold ctl->read_lock and ensure event_count > 0 */
+static void snd_ctl_dequeue_event(struct snd_ctl_file *ctl,
+				  struct snd_ctl_event *ev)
+{
+	struct snd_kctl_event *kev = &ctl->events[ctl->event_head];
+	unsigned short *link;
+
+	ev->type = SNDRV_CTL_EVENT_ELEM;
+	ev->data.elem.mask = kev->mask;
+	ev->data.elem.id = kev->id;
+	link = &ctl->event_hash[kev->id.numid & (ctl->event_size - 1)];
+	while (*link != ctl->event_head + 1)
+		link = &ctl->events[*link - 1].hnext;
+	*link = kev->hnext;
+	ctl->event_head = (ctl->event_head + 1) & (ctl->event_size - 1);
+	ctl->event_count--;
 }
 
 static int snd_ctl_release(struct inode *inode, struct file *file)
@@ -133,6 +247,7 @@ static int snd_ctl_release(struct inode *inode, struct file *file)
 			if (control->vd[idx].owner == ctl)
 				control->vd[idx].owner = NULL;
 	up_write(&card->controls_rwsem);
+	del_timer_sync(&ctl->event_timer);
 	snd_ctl_empty_read_queue(ctl);
 	put_pid(ctl->pid);
 	kfree(ctl);
@@ -141,12 +256,59 @@ static int snd_ctl_release(struct inode *inode, struct file *file)
 	return 0;
 }
 
+/* the caller must hold ctl->read_lock */
+static bool snd_ctl_event_wanted(struct snd_ctl_file *ctl, unsigned int mask,
+				 struct snd_ctl_elem_id *id)
+{
+	if (ctl->filter_ifaces && !(ctl->filter_ifaces & (1U << id->iface)))
+		return false;
+	if (id->numid < ctl->filter_numid_min ||
+	    id->numid > ctl->filter_numid_max)
+		return false;
+	return (mask & ctl->filter_events) != 0;
+}
+
+/*
+ * Decide whether a queued event wakes up the reader now.  Pure VALUE
+ * changes are held back until min_interval_ms has passed since the
+ * last wakeup; they coalesce in the ring meanwhile and the event
+ * timer delivers them.  The caller must hold ctl->read_lock.
+ */
+static bool snd_ctl_event_wake_now(struct snd_ctl_file *ctl,
+				   unsigned int mask)
+{
+	unsigned long next;
+
+	if (ctl->event_interval && mask == SNDRV_CTL_EVENT_MASK_VALUE) {
+		next = ctl->event_last_wake + ctl->event_interval;
+		if (time_before(jiffies, next)) {
+			if (!timer_pending(&ctl->event_timer))
+				mod_timer(&ctl->event_timer, next);
+			return false;
+		}
+	}
+	ctl->event_last_wake = jiffies;
+	return true;
+}
+
+static void snd_ctl_event_timer(unsigned long data)
+{
+	struct snd_ctl_file *ctl = (struct snd_ctl_file *)data;
+	unsigned long flags;
+
+	spin_lock_irqsave(&ctl->read_lock, flags);
+	ctl->event_last_wake = jiffies;
+	wake_up(&ctl->change_sleep);
+	spin_unlock_irqrestore(&ctl->read_lock, flags);
+	kill_fasync(&ctl->fasync, SIGIO, POLL_IN);
+}
+
 void snd_ctl_notify(struct snd_card *card, unsigned int mask,
 		    struct snd_ctl_elem_id *id)
 {
 	unsigned long flags;
 	struct snd_ctl_file *ctl;
-	struct snd_kctl_event *ev;
+	bool wake;
 	
 	if (snd_BUG_ON(!card || !id))
 		return;
@@ -158,24 +320,17 @@ void snd_ctl_notify(struct snd_card *card, unsigned int mask,
 		if (!ctl->subscribed)
 			continue;
 		spin_lock_irqsave(&ctl->read_lock, flags);
-		list_for_each_entry(ev, &ctl->events, list) {
-			if (ev->id.numid == id->numid) {
-				ev->mask |= mask;
-				goto _found;
-			}
-		}
-		ev = kzalloc(sizeof(*ev), GFP_ATOMIC);
-		if (ev) {
-			ev->id = *id;
-			ev->mask = mask;
-			list_add_tail(&ev->list, &ctl->events);
-		} else {
-			snd_printk(KERN_ERR "No memory available to allocate event\n");
+		if (!snd_ctl_event_wanted(ctl, mask, id)) {
+			spin_unlock_irqrestore(&ctl->read_lock, flags);
+			continue;
 		}
-	_found:
-		wake_up(&ctl->change_sleep);
+		snd_ctl_queue_event(ctl, mask, id);
+		wake = snd_ctl_event_wake_now(ctl, mask);
+		if (wake)
+			wake_up(&ctl->change_sleep);
 		spin_unlock_irqrestore(&ctl->read_lock, flags);
-		kill_fasync(&ctl->fasync, SIGIO, POLL_IN);
+		if (wake)
+			kill_fasync(&ctl->fasync, SIGIO, POLL_IN);
 	}
 	read_unlock(&card->ctl_files_rwlock);
 }
@@ -273,28 +428,84 @@ EXPORT_SYMBOL(snd_ctl_new1);
  * or snd_ctl_new1().
  * Don't call this after the control was added to the card.
  */
+static void snd_ctl_free_rcu(struct rcu_head *head)
+{
+	struct snd_kcontrol *kcontrol =
+		container_of(head, struct snd_kcontrol, rcu);
+
+	kfree(kcontrol->shadow);
+	kfree(kcontrol);
+}
+
 void snd_ctl_free_one(struct snd_kcontrol *kcontrol)
 {
 	if (kcontrol) {
 		if (kcontrol->private_free)
 			kcontrol->private_free(kcontrol);
-		kfree(kcontrol);
+		/* shadow readers may still look at it, see snd_ctl_elem_read() */
+		call_rcu(&kcontrol->rcu, snd_ctl_free_rcu);
 	}
 }
 
 EXPORT_SYMBOL(snd_ctl_free_one);
 
+/*
+ * Controls are indexed twice per card: card->ctl_numids maps every
+ * element numid to its control, and card->ctl_hash chains the controls
+ * by (iface, name).  The device, subdevice and index fields are not
+ * hashed since a control covers a range of indices, and many drivers
+ * still set them after adding the control (e.g. the S/PDIF controls
+ * of ymfpci, ice1712 and cmipci); they are checked while walking the
+ * bucket.  Both are protected by controls_rwsem.  Change the iface or
+ * the name of an added control only via snd_ctl_rename_id() or
+ * snd_ctl_rename().
+ */
+static unsigned int snd_ctl_id_hash(const struct snd_ctl_elem_id *id)
+{
+	unsigned int h;
+
+	h = full_name_hash(id->name, strnlen(id->name, sizeof(id->name)));
+	h ^= id->iface << 24;
+	return hash_32(h, SNDRV_CTL_HASH_BITS);
+}
+
+static int snd_ctl_numid_insert(struct snd_card *card,
+				struct snd_kcontrol *kctl, unsigned int numid)
+{
+	unsigned int idx;
+	int err;
+
+	for (idx = 0; idx < kctl->count; idx++) {
+		err = radix_tree_insert(&card->ctl_numids, numid + idx, kctl);
+		if (err < 0) {
+			while (idx--)
+				radix_tree_delete(&card->ctl_numids, numid + idx);
+			return err;
+		}
+	}
+	return 0;
+}
+
+static void snd_ctl_numid_delete(struct snd_card *card,
+				 struct snd_kcontrol *kctl, unsigned int numid)
+{
+	unsigned int idx;
+
+	for (idx = 0; idx < kctl->count; idx++)
+		radix_tree_delete(&card->ctl_numids, numid + idx);
+}
+
 static bool snd_ctl_remove_numid_conflict(struct snd_card *card,
 					  unsigned int count)
 {
 	struct snd_kcontrol *kctl;
 
-	list_for_each_entry(kctl, &card->controls, list) {
-		if (kctl->id.numid < card->last_numid + 1 + count &&
-		    kctl->id.numid + kctl->count > card->last_numid + 1) {
-		    	card->last_numid = kctl->id.numid + kctl->count - 1;
-			return true;
-		}
+	if (!radix_tree_gang_lookup(&card->ctl_numids, (void **)&kctl,
+				    card->last_numid + 1, 1))
+		return false;
+	if (kctl->id.numid < card->last_numid + 1 + count) {
+		card->last_numid = kctl->id.numid + kctl->count - 1;
+		return true;
 	}
 	return false;
 }
@@ -313,6 +524,28 @@ static int snd_ctl_find_hole(struct snd_card *card, unsigned int count)
 	return 0;
 }
 
+/*
+ * Assign numids to a new control and link it to the card; the caller
+ * must hold controls_rwsem for writing.
+ */
+static int snd_ctl_link(struct snd_card *card, struct snd_kcontrol *kcontrol)
+{
+	int err;
+
+	if (snd_ctl_find_hole(card, kcontrol->count) < 0)
+		return -ENOMEM;
+	err = snd_ctl_numid_insert(card, kcontrol, card->last_numid + 1);
+	if (err < 0)
+		return err;
+	hlist_add_head(&kcontrol->hash,
+		       &card->ctl_hash[snd_ctl_id_hash(&kcontrol->id)]);
+	list_add_tail(&kcontrol->list, &card->controls);
+	card->controls_count += kcontrol->count;
+	kcontrol->id.numid = card->last_numid + 1;
+	card->last_numid += kcontrol->count;
+	return 0;
+}
+
 /**
  * snd_ctl_add - add the control instance to the card
  * @card: the card instance
@@ -350,15 +583,11 @@ int snd_ctl_add(struct snd_card *card, struct snd_kcontrol *kcontrol)
 		err = -EBUSY;
 		goto error;
 	}
-	if (snd_ctl_find_hole(card, kcontrol->count) < 0) {
+	err = snd_ctl_link(card, kcontrol);
+	if (err < 0) {
 		up_write(&card->controls_rwsem);
-		err = -ENOMEM;
 		goto error;
 	}
-	list_add_tail(&kcontrol->list, &card->controls);
-	card->controls_count += kcontrol->count;
-	kcontrol->id.numid = card->last_numid + 1;
-	card->last_numid += kcontrol->count;
 	up_write(&card->controls_rwsem);
 	for (idx = 0; idx < kcontrol->count; idx++, id.index++, id.numid++)
 		snd_ctl_notify(card, SNDRV_CTL_EVENT_MASK_ADD, &id);
@@ -415,15 +644,11 @@ int snd_ctl_replace(struct snd_card *card, struct snd_kcontrol *kcontrol,
 		goto error;
 	}
 add:
-	if (snd_ctl_find_hole(card, kcontrol->count) < 0) {
+	ret = snd_ctl_link(card, kcontrol);
+	if (ret < 0) {
 		up_write(&card->controls_rwsem);
-		ret = -ENOMEM;
 		goto error;
 	}
-	list_add_tail(&kcontrol->list, &card->controls);
-	card->controls_count += kcontrol->count;
-	kcontrol->id.numid = card->last_numid + 1;
-	card->last_numid += kcontrol->count;
 	up_write(&card->controls_rwsem);
 	for (idx = 0; idx < kcontrol->count; idx++, id.index++, id.numid++)
 		snd_ctl_notify(card, SNDRV_CTL_EVENT_MASK_ADD, &id);
@@ -454,6 +679,8 @@ int snd_ctl_remove(struct snd_card *card, struct snd_kcontrol *kcontrol)
 	if (snd_BUG_ON(!card || !kcontrol))
 		return -EINVAL;
 	list_del(&kcontrol->list);
+	hlist_del(&kcontrol->hash);
+	snd_ctl_numid_delete(card, kcontrol, kcontrol->id.numid);
 	card->controls_count -= kcontrol->count;
 	id = kcontrol->id;
 	for (idx = 0; idx < kcontrol->count; idx++, id.index++, id.numid++)
@@ -594,6 +821,8 @@ int snd_ctl_rename_id(struct snd_card *card, struct snd_ctl_elem_id *src_id,
 		      struct snd_ctl_elem_id *dst_id)
 {
 	struct snd_kcontrol *kctl;
+	unsigned long flags;
+	int err;
 
 	down_write(&card->controls_rwsem);
 	kctl = snd_ctl_find_id(card, src_id);
@@ -601,15 +830,58 @@ int snd_ctl_rename_id(struct snd_card *card, struct snd_ctl_elem_id *src_id,
 		up_write(&card->controls_rwsem);
 		return -ENOENT;
 	}
+	err = snd_ctl_numid_insert(card, kctl, card->last_numid + 1);
+	if (err < 0) {
+		up_write(&card->controls_rwsem);
+		return err;
+	}
+	snd_ctl_numid_delete(card, kctl, kctl->id.numid);
+	hlist_del(&kctl->hash);
+	/* lockless readers of a shadowed control may still see it */
+	if (kctl->shadow)
+		write_seqlock_irqsave(&kctl->shadow->lock, flags);
 	kctl->id = *dst_id;
 	kctl->id.numid = card->last_numid + 1;
+	if (kctl->shadow)
+		write_sequnlock_irqrestore(&kctl->shadow->lock, flags);
 	card->last_numid += kctl->count;
+	hlist_add_head(&kctl->hash, &card->ctl_hash[snd_ctl_id_hash(&kctl->id)]);
 	up_write(&card->controls_rwsem);
 	return 0;
 }
 
 EXPORT_SYMBOL(snd_ctl_rename_id);
 
+/**
+ * snd_ctl_rename - rename the control on the card
+ * @card: the card instance
+ * @kctl: the control to rename
+ * @name: the new name
+ *
+ * Renames the specified control on the card to the new name.  Unlike
+ * snd_ctl_rename_id(), the numid is kept.  Drivers must use this (or
+ * snd_ctl_rename_id()) instead of writing kctl->id.name of an added
+ * control, so that the control is moved to the hash bucket of its new
+ * name.
+ */
+void snd_ctl_rename(struct snd_card *card, struct snd_kcontrol *kctl,
+		    const char *name)
+{
+	unsigned long flags;
+
+	down_write(&card->controls_rwsem);
+	hlist_del(&kctl->hash);
+	if (kctl->shadow)
+		write_seqlock_irqsave(&kctl->shadow->lock, flags);
+	memset(kctl->id.name, 0, sizeof(kctl->id.name));
+	strlcpy(kctl->id.name, name, sizeof(kctl->id.name));
+	if (kctl->shadow)
+		write_sequnlock_irqrestore(&kctl->shadow->lock, flags);
+	hlist_add_head(&kctl->hash, &card->ctl_hash[snd_ctl_id_hash(&kctl->id)]);
+	up_write(&card->controls_rwsem);
+}
+EXPORT_SYMBOL(snd_ctl_rename);
+
 /**
  * snd_ctl_find_numid - find the control instance with the given number-id
  * @card: the card instance
@@ -625,15 +897,9 @@ EXPORT_SYMBOL(snd_ctl_rename_id);
  */
 struct snd_kcontrol *snd_ctl_find_numid(struct snd_card *card, unsigned int numid)
 {
-	struct snd_kcontrol *kctl;
-
 	if (snd_BUG_ON(!card || !numid))
 		return NULL;
-	list_for_each_entry(kctl, &card->controls, list) {
-		if (kctl->id.numid <= numid && kctl->id.numid + kctl->count > numid)
-			return kctl;
-	}
-	return NULL;
+	return radix_tree_lookup(&card->ctl_numids, numid);
 }
 
 EXPORT_SYMBOL(snd_ctl_find_numid);
@@ -660,7 +926,8 @@ struct snd_kcontrol *snd_ctl_find_id(struct snd_card *card,
 		return NULL;
 	if (id->numid != 0)
 		return snd_ctl_find_numid(card, id->numid);
-	list_for_each_entry(kctl, &card->controls, list) {
+	hlist_for_each_entry(kctl, &card->ctl_hash[snd_ctl_id_hash(id)],
+			     hash) {
 		if (kctl->id.iface != id->iface)
 			continue;
 		if (kctl->id.device != id->device)
@@ -826,28 +1093,240 @@ static int snd_ctl_elem_info_user(struct snd_ctl_file *ctl,
 	return result;
 }
 
-static int snd_ctl_elem_read(struct snd_card *card,
-			     struct snd_ctl_elem_value *control)
+/**
+ * snd_ctl_shadow_init - let the core keep a copy of the control values
+ * @kctl: the control instance, not yet added to the card
+ * @size: bytes of the value union to keep per element, 0 for all
+ *
+ * Non-volatile elements of a shadowed control are read from the copy
+ * when it is valid, without calling the get callback (and, for reads by
+ * numid, without taking controls_rwsem).  The copy is filled from each successful get and dropped by
+ * each put; a driver that changes values on its own must either publish
+ * them with snd_ctl_shadow_update() or call snd_ctl_shadow_invalidate()
+ * before notifying.  Elements with SNDRV_CTL_ELEM_ACCESS_VOLATILE always
+ * go to the driver.
+ *
+ * Return: Zero if successful, or a negative error code on failure.
+ */
+int snd_ctl_shadow_init(struct snd_kcontrol *kctl, size_t size)
 {
-	struct snd_kcontrol *kctl;
-	struct snd_kcontrol_volatile *vd;
+	struct snd_kcontrol_shadow *shadow;
+	size_t bitmap;
+
+	if (snd_BUG_ON(!kctl || kctl->shadow))
+		return -EINVAL;
+	if (!size || size > sizeof(((struct snd_ctl_elem_value *)0)->value))
+		size = sizeof(((struct snd_ctl_elem_value *)0)->value);
+	bitmap = BITS_TO_LONGS(kctl->count) * sizeof(long);
+	shadow = kzalloc(sizeof(*shadow) + bitmap + kctl->count * size,
+			 GFP_KERNEL);
+	if (!shadow)
+		return -ENOMEM;
+	seqlock_init(&shadow->lock);
+	shadow->size = size;
+	shadow->valid = (unsigned long *)(shadow + 1);
+	shadow->values = (unsigned char *)shadow->valid + bitmap;
+	kctl->shadow = shadow;
+	return 0;
+}
+
+EXPORT_SYMBOL(snd_ctl_shadow_init);
+
+/*
+ * Store a value read by get; it is dropped if the shadow was updated or
+ * invalidated since the get started (gen taken before calling it), so
+ * that a racing put can't be hidden by a stale value.
+ */
+static void snd_ctl_shadow_store(struct snd_kcontrol *kctl,
+				 unsigned int index_offset,
+				 struct snd_ctl_elem_value *control,
+				 unsigned int gen)
+{
+	struct snd_kcontrol_shadow *shadow = kctl->shadow;
+	unsigned long flags;
+
+	write_seqlock_irqsave(&shadow->lock, flags);
+	if (shadow->gen == gen) {
+		memcpy(shadow->values + index_offset * shadow->size,
+		       &control->value, shadow->size);
+		__set_bit(index_offset, shadow->valid);
+	}
+	write_sequnlock_irqrestore(&shadow->lock, flags);
+}
+
+/**
+ * snd_ctl_shadow_update - publish the current value of an element
+ * @kctl: the shadowed control instance
+ * @ucontrol: the new value, with the element id
+ *
+ * Can be called from any context.
+ */
+void snd_ctl_shadow_update(struct snd_kcontrol *kctl,
+			   struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_kcontrol_shadow *shadow = kctl->shadow;
 	unsigned int index_offset;
+	unsigned long flags;
+
+	if (!shadow)
+		return;
+	index_offset = snd_ctl_get_ioff(kctl, &ucontrol->id);
+	write_seqlock_irqsave(&shadow->lock, flags);
+	shadow->gen++;
+	memcpy(shadow->values + index_offset * shadow->size,
+	       &ucontrol->value, shadow->size);
+	__set_bit(index_offset, shadow->valid);
+	write_sequnlock_irqrestore(&shadow->lock, flags);
+}
+
+EXPORT_SYMBOL(snd_ctl_shadow_update);
+
+/**
+ * snd_ctl_shadow_invalidate - drop the values kept for a control
+ * @kctl: the control instance
+ *
+ * The next read of each element calls the get callback again.
+ * Can be called from any context; does nothing for controls
+ * without a shadow.
+ */
+void snd_ctl_shadow_invalidate(struct snd_kcontrol *kctl)
+{
+	struct snd_kcontrol_shadow *shadow = kctl->shadow;
+	unsigned long flags;
+
+	if (!shadow)
+		return;
+	write_seqlock_irqsave(&shadow->lock, flags);
+	shadow->gen++;
+	bitmap_zero(shadow->valid, kctl->count);
+	write_sequnlock_irqrestore(&shadow->lock, flags);
+}
+
+EXPORT_SYMBOL(snd_ctl_shadow_invalidate);
+
+static bool snd_ctl_shadow_read(struct snd_kcontrol *kctl,
+				unsigned int index_offset,
+				struct snd_ctl_elem_value *control)
+{
+	struct snd_kcontrol_shadow *shadow = kctl->shadow;
+	unsigned int seq;
+	bool hit;
+
+	if (!shadow ||
+	    (kctl->vd[index_offset].access & SNDRV_CTL_ELEM_ACCESS_VOLATILE))
+		return false;
+	do {
+		seq = read_seqbegin(&shadow->lock);
+		hit = test_bit(index_offset, shadow->valid);
+		if (hit)
+			memcpy(&control->value,
+			       shadow->values + index_offset * shadow->size,
+			       shadow->size);
+	} while (read_seqretry(&shadow->lock, seq));
+	if (hit && shadow->size < sizeof(control->value))
+		memset((unsigned char *)&control->value + shadow->size, 0,
+		       sizeof(control->value) - shadow->size);
+	return hit;
+}
+
+/*
+ * Serve a read by numid from the shadow without controls_rwsem: the
+ * numid index is RCU-safe and controls are freed after a grace period.
+ * snd_ctl_rename_id() rewrites the id of a control that may still be
+ * found under its old numid, so the id is copied under the shadow lock
+ * and a numid that no longer belongs to the control falls back to the
+ * locked path.
+ */
+static bool snd_ctl_elem_read_rcu(struct snd_card *card,
+				  struct snd_ctl_elem_value *control)
+{
+	struct snd_kcontrol *kctl;
+	struct snd_ctl_elem_id id;
+	unsigned int index_offset, seq;
+	bool hit = false;
+
+	if (!control->id.numid)
+		return false;
+	rcu_read_lock();
+	kctl = radix_tree_lookup(&card->ctl_numids, control->id.numid);
+	if (!kctl || !kctl->shadow)
+		goto unlock;
+	do {
+		seq = read_seqbegin(&kctl->shadow->lock);
+		id = kctl->id;
+	} while (read_seqretry(&kctl->shadow->lock, seq));
+	index_offset = control->id.numid - id.numid;
+	if (index_offset >= kctl->count)
+		goto unlock;	/* renamed meanwhile */
+	if ((kctl->vd[index_offset].access & SNDRV_CTL_ELEM_ACCESS_READ) &&
+	    snd_ctl_shadow_read(kctl, index_offset, control)) {
+		control->id = id;
+		control->id.index += index_offset;
+		control->id.numid += index_offset;
+		hit = true;
+	}
+ unlock:
+	rcu_read_unlock();
+	return hit;
+}
+
+/* call get for a looked-up element, going through the shadow if any */
+static int snd_ctl_elem_get(struct snd_kcontrol *kctl,
+			    struct snd_ctl_elem_value *control)
+{
+	unsigned int index_offset = snd_ctl_get_ioff(kctl, &control->id);
+	unsigned int gen = 0;
 	int result;
 
-	down_read(&card->controls_rwsem);
+	if (snd_ctl_shadow_read(kctl, index_offset, control))
+		return 0;
+	if (kctl->shadow)
+		gen = ACCESS_ONCE(kctl->shadow->gen);
+	result = kctl->get(kctl, control);
+	if (result >= 0 && kctl->shadow &&
+	    !(kctl->vd[index_offset].access & SNDRV_CTL_ELEM_ACCESS_VOLATILE))
+		snd_ctl_shadow_store(kctl, index_offset, control, gen);
+	return result;
+}
+
+/*
+ * Look up a readable element and fix up its id; the caller must hold
+ * controls_rwsem.
+ */
+static struct snd_kcontrol *
+snd_ctl_elem_read_find(struct snd_card *card,
+		       struct snd_ctl_elem_value *control, int *result)
+{
+	struct snd_kcontrol *kctl;
+	unsigned int index_offset;
+
 	kctl = snd_ctl_find_id(card, &control->id);
 	if (kctl == NULL) {
-		result = -ENOENT;
-	} else {
-		index_offset = snd_ctl_get_ioff(kctl, &control->id);
-		vd = &kctl->vd[index_offset];
-		if ((vd->access & SNDRV_CTL_ELEM_ACCESS_READ) &&
-		    kctl->get != NULL) {
-			snd_ctl_build_ioff(&control->id, kctl, index_offset);
-			result = kctl->get(kctl, control);
-		} else
-			result = -EPERM;
+		*result = -ENOENT;
+		return NULL;
 	}
+	index_offset = snd_ctl_get_ioff(kctl, &control->id);
+	if (!(kctl->vd[index_offset].access & SNDRV_CTL_ELEM_ACCESS_READ) ||
+	    kctl->get == NULL) {
+		*result = -EPERM;
+		return NULL;
+	}
+	snd_ctl_build_ioff(&control->id, kctl, index_offset);
+	return kctl;
+}
+
+static int snd_ctl_elem_read(struct snd_card *card,
+			     struct snd_ctl_elem_value *control)
+{
+	struct snd_kcontrol *kctl;
+	int result;
+
+	if (snd_ctl_elem_read_rcu(card, control))
+		return 0;
+	down_read(&card->controls_rwsem);
+	kctl = snd_ctl_elem_read_find(card, control, &result);
+	if (kctl)
+		result = snd_ctl_elem_get(kctl, control);
 	up_read(&card->controls_rwsem);
 	return result;
 }
@@ -874,37 +1353,47 @@ static int snd_ctl_elem_read_user(struct snd_card *card,
 	return result;
 }
 
-static int snd_ctl_elem_write(struct snd_card *card, struct snd_ctl_file *file,
-			      struct snd_ctl_elem_value *control)
+/*
+ * Write one element; the caller must hold controls_rwsem.
+ * Returns 1 if the value was changed and must be notified.
+ */
+static int __snd_ctl_elem_write(struct snd_card *card,
+				struct snd_ctl_file *file,
+				struct snd_ctl_elem_value *control)
 {
 	struct snd_kcontrol *kctl;
 	struct snd_kcontrol_volatile *vd;
 	unsigned int index_offset;
 	int result;
 
-	down_read(&card->controls_rwsem);
 	kctl = snd_ctl_find_id(card, &control->id);
-	if (kctl == NULL) {
-		result = -ENOENT;
-	} else {
-		index_offset = snd_ctl_get_ioff(kctl, &control->id);
-		vd = &kctl->vd[index_offset];
-		if (!(vd->access & SNDRV_CTL_ELEM_ACCESS_WRITE) ||
-		    kctl->put == NULL ||
-		    (file && vd->owner && vd->owner != file)) {
-			result = -EPERM;
-		} else {
-			snd_ctl_build_ioff(&control->id, kctl, index_offset);
-			result = kctl->put(kctl, control);
-		}
-		if (result > 0) {
-			up_read(&card->controls_rwsem);
-			snd_ctl_notify(card, SNDRV_CTL_EVENT_MASK_VALUE,
-				       &control->id);
-			return 0;
-		}
-	}
+	if (kctl == NULL)
+		return -ENOENT;
+	index_offset = snd_ctl_get_ioff(kctl, &control->id);
+	vd = &kctl->vd[index_offset];
+	if (!(vd->access & SNDRV_CTL_ELEM_ACCESS_WRITE) ||
+	    kctl->put == NULL ||
+	    (file && vd->owner && vd->owner != file))
+		return -EPERM;
+	snd_ctl_build_ioff(&control->id, kctl, index_offset);
+	result = kctl->put(kctl, control);
+	snd_ctl_shadow_invalidate(kctl);
+	return result;
+}
+
+static int snd_ctl_elem_write(struct snd_card *card, struct snd_ctl_file *file,
+			      struct snd_ctl_elem_value *control)
+{
+	int result;
+
+	down_read(&card->controls_rwsem);
+	result = __snd_ctl_elem_write(card, file, control);
 	up_read(&card->controls_rwsem);
+	if (result > 0) {
+		snd_ctl_notify(card, SNDRV_CTL_EVENT_MASK_VALUE,
+			       &control->id);
+		return 0;
+	}
 	return result;
 }
 
@@ -932,6 +1421,105 @@ static int snd_ctl_elem_write_user(struct snd_ctl_file *file,
 	return result;
 }
 
+/* read a chunk of values; the caller must hold controls_rwsem */
+static int snd_ctl_elem_read_many(struct snd_card *card,
+				  struct snd_ctl_elem_value *values,
+				  unsigned int count, unsigned int *done)
+{
+	struct snd_kcontrol *kctl;
+	unsigned int i;
+	int result = 0;
+
+	for (i = 0; i < count; i++) {
+		kctl = snd_ctl_elem_read_find(card, &values[i], &result);
+		if (!kctl)
+			break;
+		result = snd_ctl_elem_get(kctl, &values[i]);
+		if (result < 0)
+			break;
+	}
+	*done = i;
+	return result;
+}
+
+/* write a chunk of values; the caller must hold controls_rwsem */
+static int snd_ctl_elem_write_many(struct snd_ctl_file *file,
+				   struct snd_ctl_elem_value *values,
+				   unsigned int count, unsigned int *done)
+{
+	unsigned int i;
+	int result = 0;
+
+	for (i = 0; i < count; i++) {
+		result = __snd_ctl_elem_write(file->card, file, &values[i]);
+		if (result < 0)
+			break;
+		if (result > 0)
+			snd_ctl_notify(file->card, SNDRV_CTL_EVENT_MASK_VALUE,
+				       &values[i].id);
+		result = 0;
+	}
+	*done = i;
+	return result;
+}
+
+/*
+ * ELEM_READ_MULTI / ELEM_WRITE_MULTI: handle an array of values with a
+ * single power check and a single hold of controls_rwsem.  Processing
+ * stops at the first failing element; done tells how many succeeded.
+ */
+static int snd_ctl_elem_rw_multi(struct snd_ctl_file *file,
+				 struct snd_ctl_elem_values __user *_values,
+				 int write)
+{
+	struct snd_card *card = file->card;
+	struct snd_ctl_elem_values values;
+	struct snd_ctl_elem_value *buf;
+	unsigned int done = 0, n, processed;
+	int result;
+
+	if (copy_from_user(&values, _values, sizeof(values)))
+		return -EFAULT;
+	buf = kmalloc(SND_CTL_ELEM_MULTI_CHUNK * sizeof(*buf), GFP_KERNEL);
+	if (buf == NULL)
+		return -ENOMEM;
+
+	snd_power_lock(card);
+	result = snd_power_wait(card, SNDRV_CTL_POWER_D0);
+	if (result < 0)
+		goto unlock_power;
+	down_read(&card->controls_rwsem);
+	while (done < values.count) {
+		n = min_t(unsigned int, values.count - done,
+			  SND_CTL_ELEM_MULTI_CHUNK);
+		if (copy_from_user(buf, values.pvalues + done,
+				   n * sizeof(*buf))) {
+			result = -EFAULT;
+			break;
+		}
+		if (write)
+			result = snd_ctl_elem_write_many(file, buf, n,
+							 &processed);
+		else
+			result = snd_ctl_elem_read_many(card, buf, n,
+							&processed);
+		if (copy_to_user(values.pvalues + done, buf,
+				 processed * sizeof(*buf)))
+			result = -EFAULT;
+		else
+			done += processed;
+		if (result < 0)
+			break;
+	}
+	up_read(&card->controls_rwsem);
+ unlock_power:
+	snd_power_unlock(card);
+	kfree(buf);
+	if (put_user(done, &_values->done))
+		return -EFAULT;
+	return result;
+}
+
 static int snd_ctl_elem_lock(struct snd_ctl_file *file,
 			     struct snd_ctl_elem_id __user *_id)
 {
@@ -1274,15 +1862,43 @@ static int snd_ctl_subscribe_events(struct snd_ctl_file *file, int __user *ptr)
 		return 0;
 	}
 	if (subscribe) {
+		if (!file->subscribed) {
+			int err = snd_ctl_alloc_read_queue(file);
+			if (err < 0)
+				return err;
+		}
 		file->subscribed = 1;
 		return 0;
 	} else if (file->subscribed) {
-		snd_ctl_empty_read_queue(file);
 		file->subscribed = 0;
+		snd_ctl_empty_read_queue(file);
 	}
 	return 0;
 }
 
+static int snd_ctl_subscribe_filter(struct snd_ctl_file *file,
+				    struct snd_ctl_event_filter __user *_filter)
+{
+	struct snd_ctl_event_filter filter;
+
+	if (copy_from_user(&filter, _filter, sizeof(filter)))
+		return -EFAULT;
+	if (filter.iface_mask & ~((2U << SNDRV_CTL_ELEM_IFACE_LAST) - 1))
+		return -EINVAL;
+	if (!filter.numid_max)
+		filter.numid_max = UINT_MAX;
+	if (filter.numid_min > filter.numid_max)
+		return -EINVAL;
+	spin_lock_irq(&file->read_lock);
+	file->filter_ifaces = filter.iface_mask;
+	file->filter_numid_min = filter.numid_min;
+	file->filter_numid_max = filter.numid_max;
+	file->filter_events = filter.event_mask ? filter.event_mask : ~0U;
+	file->event_interval = msecs_to_jiffies(filter.min_interval_ms);
+	spin_unlock_irq(&file->read_lock);
+	return 0;
+}
+
 static int snd_ctl_tlv_ioctl(struct snd_ctl_file *file,
                              struct snd_ctl_tlv __user *_tlv,
                              int op_flag)
@@ -1370,6 +1986,10 @@ static long snd_ctl_ioctl(struct file *file, unsigned int cmd, unsigned long arg
 		return snd_ctl_elem_read_user(card, argp);
 	case SNDRV_CTL_IOCTL_ELEM_WRITE:
 		return snd_ctl_elem_write_user(ctl, argp);
+	case SNDRV_CTL_IOCTL_ELEM_READ_MULTI:
+		return snd_ctl_elem_rw_multi(ctl, argp, 0);
+	case SNDRV_CTL_IOCTL_ELEM_WRITE_MULTI:
+		return snd_ctl_elem_rw_multi(ctl, argp, 1);
 	case SNDRV_CTL_IOCTL_ELEM_LOCK:
 		return snd_ctl_elem_lock(ctl, argp);
 	case SNDRV_CTL_IOCTL_ELEM_UNLOCK:
@@ -1382,6 +2002,8 @@ static long snd_ctl_ioctl(struct file *file, unsigned int cmd, unsigned long arg
 		return snd_ctl_elem_remove(ctl, argp);
 	case SNDRV_CTL_IOCTL_SUBSCRIBE_EVENTS:
 		return snd_ctl_subscribe_events(ctl, ip);
+	case SNDRV_CTL_IOCTL_SUBSCRIBE_FILTER:
+		return snd_ctl_subscribe_filter(ctl, argp);
 	case SNDRV_CTL_IOCTL_TLV_READ:
 		return snd_ctl_tlv_ioctl(ctl, argp, 0);
 	case SNDRV_CTL_IOCTL_TLV_WRITE:
@@ -1427,8 +2049,7 @@ static ssize_t snd_ctl_read(struct file *file, char __user *buffer,
 	spin_lock_irq(&ctl->read_lock);
 	while (count >= sizeof(struct snd_ctl_event)) {
 		struct snd_ctl_event ev;
-		struct snd_kctl_event *kev;
-		while (list_empty(&ctl->events)) {
+		while (!ctl->event_count && !ctl->event_overrun) {
 			wait_queue_t wait;
 			if ((file->f_flags & O_NONBLOCK) != 0 || result > 0) {
 				err = -EAGAIN;
@@ -1446,13 +2067,14 @@ static ssize_t snd_ctl_read(struct file *file, char __user *buffer,
 				return -ERESTARTSYS;
 			spin_lock_irq(&ctl->read_lock);
 		}
-		kev = snd_kctl_event(ctl->events.next);
-		ev.type = SNDRV_CTL_EVENT_ELEM;
-		ev.data.elem.mask = kev->mask;
-		ev.data.elem.id = kev->id;
-		list_del(&kev->list);
+		if (ctl->event_overrun) {
+			memset(&ev, 0, sizeof(ev));
+			ev.type = SNDRV_CTL_EVENT_OVERRUN;
+			ctl->event_overrun = 0;
+		} else {
+			snd_ctl_dequeue_event(ctl, &ev);
+		}
 		spin_unlock_irq(&ctl->read_lock);
-		kfree(kev);
 		if (copy_to_user(buffer, &ev, sizeof(struct snd_ctl_event))) {
 			err = -EFAULT;
 			goto __end;
@@ -1479,7 +2101,7 @@ static unsigned int snd_ctl_poll(struct file *file, poll_table * wait)
 	poll_wait(file, &ctl->change_sleep, wait);
 
 	mask = 0;
-	if (!list_empty(&ctl->events))
+	if (ctl->event_count || ctl->event_overrun)
 		mask |= POLLIN | POLLRDNORM;
 
 	return mask;
@@ -335,6 +335,62 @@ static int snd_ctl_elem_write_user_compat(struct snd_ctl_file *file,
 	return err;
 }
 
+struct snd_ctl_elem_values32 {
+	u32 count;
+	u32 done;
+	u32 pvalues;
+	unsigned char reserved[48];
+};
+
+/*
+ * ELEM_READ_MULTI / ELEM_WRITE_MULTI: each value has to be converted
+ * according to its type, so they are handled one by one
+ */
+static int snd_ctl_elem_rw_multi_compat(struct snd_ctl_file *file,
+					struct snd_ctl_elem_values32 __user *data32,
+					int write)
+{
+	struct snd_card *card = file->card;
+	struct snd_ctl_elem_value32 __user *values32;
+	struct snd_ctl_elem_value *data;
+	unsigned int count, done = 0;
+	u32 pvalues;
+	int err, type, elem_count;
+
+	if (get_user(count, &data32->count) ||
+	    get_user(pvalues, &data32->pvalues))
+		return -EFAULT;
+	values32 = compat_ptr(pvalues);
+
+	data = kmalloc(sizeof(*data), GFP_KERNEL);
+	if (data == NULL)
+		return -ENOMEM;
+
+	snd_power_lock(card);
+	err = snd_power_wait(card, SNDRV_CTL_POWER_D0);
+	while (err >= 0 && done < count) {
+		memset(data, 0, sizeof(*data));
+		err = copy_ctl_value_from_user(card, data, &values32[done],
+					       &type, &elem_count);
+		if (err < 0)
+			break;
+		if (write)
+			err = snd_ctl_elem_write(card, file, data);
+		else
+			err = snd_ctl_elem_read(card, data);
+		if (err >= 0)
+			err = copy_ctl_value_to_user(&values32[done], data,
+						     type, elem_count);
+		if (err >= 0)
+			done++;
+	}
+	snd_power_unlock(card);
+	kfree(data);
+	if (put_user(done, &data32->done))
+		return -EFAULT;
+	return err < 0 ? err : 0;
+}
+
 /* add or replace a user control */
 static int snd_ctl_elem_add_compat(struct snd_ctl_file *file,
 				   struct snd_ctl_elem_info32 __user *data32,
@@ -393,6 +449,8 @@ enum {
 	SNDRV_CTL_IOCTL_ELEM_WRITE32 = _IOWR('U', 0x13, struct snd_ctl_elem_value32),
 	SNDRV_CTL_IOCTL_ELEM_ADD32 = _IOWR('U', 0x17, struct snd_ctl_elem_info32),
 	SNDRV_CTL_IOCTL_ELEM_REPLACE32 = _IOWR('U', 0x18, struct snd_ctl_elem_info32),
+	SNDRV_CTL_IOCTL_ELEM_READ_MULTI32 = _IOWR('U', 0x1d, struct snd_ctl_elem_values32),
+	SNDRV_CTL_IOCTL_ELEM_WRITE_MULTI32 = _IOWR('U', 0x1e, struct snd_ctl_elem_values32),
 };
 
 static inline long snd_ctl_ioctl_compat(struct file *file, unsigned int cmd, unsigned long arg)
@@ -410,6 +468,7 @@ static inline long snd_ctl_ioctl_compat(struct file *file, unsigned int cmd, uns
 	case SNDRV_CTL_IOCTL_PVERSION:
 	case SNDRV_CTL_IOCTL_CARD_INFO:
 	case SNDRV_CTL_IOCTL_SUBSCRIBE_EVENTS:
+	case SNDRV_CTL_IOCTL_SUBSCRIBE_FILTER:
 	case SNDRV_CTL_IOCTL_POWER:
 	case SNDRV_CTL_IOCTL_POWER_STATE:
 	case SNDRV_CTL_IOCTL_ELEM_LOCK:
@@ -431,6 +490,10 @@ static inline long snd_ctl_ioctl_compat(struct file *file, unsigned int cmd, uns
 		return snd_ctl_elem_add_compat(ctl, argp, 0);
 	case SNDRV_CTL_IOCTL_ELEM_REPLACE32:
 		return snd_ctl_elem_add_compat(ctl, argp, 1);
+	case SNDRV_CTL_IOCTL_ELEM_READ_MULTI32:
+		return snd_ctl_elem_rw_multi_compat(ctl, argp, 0);
+	case SNDRV_CTL_IOCTL_ELEM_WRITE_MULTI32:
+		return snd_ctl_elem_rw_multi_compat(ctl, argp, 1);
 	}
 
 	down_read(&snd_ioctl_rwsem);
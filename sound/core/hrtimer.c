@@ -35,27 +35,66 @@ MODULE_ALIAS("snd-timer-" __stringify(SNDRV_TIMER_GLOBAL_HRTIMER));
 #define NANO_SEC	1000000000UL	/* 10^9 in sec */
 static unsigned int resolution;
 
+static bool fast_irq;
+module_param(fast_irq, bool, 0444);
+MODULE_PARM_DESC(fast_irq, "Call only fast timer instances from the hrtimer interrupt and defer the others to a tasklet.");
+
 struct snd_hrtimer {
 	struct snd_timer *timer;
 	struct hrtimer hrt;
 	atomic_t running;
+	int in_callback;
+	ktime_t base;		/* absolute time of tick 0 */
+	u64 ticks;		/* ticks delivered since base */
 };
 
+/* absolute expiry of the tick @ticks after the base */
+static inline ktime_t snd_hrtimer_expiry(struct snd_hrtimer *stime, u64 ticks)
+{
+	return ktime_add_ns(stime->base, ticks * resolution);
+}
+
 static enum hrtimer_restart snd_hrtimer_callback(struct hrtimer *hrt)
 {
 	struct snd_hrtimer *stime = container_of(hrt, struct snd_hrtimer, hrt);
 	struct snd_timer *t = stime->timer;
-	unsigned long oruns;
-
-	if (!atomic_read(&stime->running))
+	enum hrtimer_restart ret = HRTIMER_NORESTART;
+	unsigned long sticks, ticks;
+	s64 late;
+
+	/*
+	 * The expiry is always base + n * resolution, so the period
+	 * error doesn't accumulate; a late interrupt only merges the
+	 * whole periods that passed meanwhile into this tick.
+	 */
+	spin_lock(&t->lock);
+	if (!atomic_read(&stime->running) || hrtimer_is_queued(hrt)) {
+		/* stopped or re-armed by snd_hrtimer_start() meanwhile */
+		spin_unlock(&t->lock);
 		return HRTIMER_NORESTART;
-
-	oruns = hrtimer_forward_now(hrt, ns_to_ktime(t->sticks * resolution));
-	snd_timer_interrupt(stime->timer, t->sticks * oruns);
-
-	if (!atomic_read(&stime->running))
-		return HRTIMER_NORESTART;
-	return HRTIMER_RESTART;
+	}
+	stime->in_callback = 1;
+	sticks = t->sticks;
+	spin_unlock(&t->lock);
+	ticks = sticks;
+	late = ktime_to_ns(ktime_sub(hrtimer_cb_get_time(hrt),
+				     hrtimer_get_expires(hrt)));
+	if (late > 0)
+		ticks += sticks * div64_u64(late, (u64)sticks * resolution);
+	stime->ticks += ticks;
+
+	snd_timer_interrupt(t, ticks);
+
+	spin_lock(&t->lock);
+	if (atomic_read(&stime->running)) {
+		/* t->sticks may have been changed by the rescheduling */
+		hrtimer_set_expires(hrt, snd_hrtimer_expiry(stime,
+						stime->ticks + t->sticks));
+		ret = HRTIMER_RESTART;
+	}
+	stime->in_callback = 0;
+	spin_unlock(&t->lock);
+	return ret;
 }
 
 static int snd_hrtimer_open(struct snd_timer *t)
@@ -65,8 +104,9 @@ static int snd_hrtimer_open(struct snd_timer *t)
 	stime = kmalloc(sizeof(*stime), GFP_KERNEL);
 	if (!stime)
 		return -ENOMEM;
-	hrtimer_init(&stime->hrt, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	hrtimer_init(&stime->hrt, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
 	stime->timer = t;
+	stime->in_callback = 0;
 	stime->hrt.function = snd_hrtimer_callback;
 	atomic_set(&stime->running, 0);
 	t->private_data = stime;
@@ -89,10 +129,17 @@ static int snd_hrtimer_start(struct snd_timer *t)
 {
 	struct snd_hrtimer *stime = t->private_data;
 
+	/* restarted from snd_timer_interrupt(); the callback re-arms */
+	if (stime->in_callback) {
+		atomic_set(&stime->running, 1);
+		return 0;
+	}
 	atomic_set(&stime->running, 0);
-	hrtimer_cancel(&stime->hrt);
-	hrtimer_start(&stime->hrt, ns_to_ktime(t->sticks * resolution),
-		      HRTIMER_MODE_REL);
+	hrtimer_try_to_cancel(&stime->hrt);
+	stime->base = hrtimer_cb_get_time(&stime->hrt);
+	stime->ticks = 0;
+	hrtimer_start(&stime->hrt, snd_hrtimer_expiry(stime, t->sticks),
+		      HRTIMER_MODE_ABS);
 	atomic_set(&stime->running, 1);
 	return 0;
 }
@@ -142,6 +189,8 @@ static int __init snd_hrtimer_init(void)
 	timer->module = THIS_MODULE;
 	strcpy(timer->name, "HR timer");
 	timer->hw = hrtimer_hw;
+	if (fast_irq)
+		timer->hw.flags &= ~SNDRV_TIMER_HW_TASKLET;
 	timer->hw.resolution = resolution;
 	timer->hw.ticks = NANO_SEC / resolution;
 
@@ -25,6 +25,9 @@
 #include <linux/time.h>
 #include <linux/mutex.h>
 #include <linux/device.h>
+#include <linux/vmalloc.h>
+#include <linux/log2.h>
+#include <linux/moduleparam.h>
 #include <sound/core.h>
 #include <sound/minors.h>
 #include <sound/pcm.h>
@@ -472,6 +475,234 @@ static void snd_pcm_substream_proc_status_read(struct snd_info_entry *entry,
 	mutex_unlock(&substream->pcm->open_mutex);
 }
 
+#define SND_PCM_TRACE_MAX	(1 << 16)
+
+static int trace_size;
+module_param(trace_size, int, 0444);
+MODULE_PARM_DESC(trace_size, "Default number of entries of the PCM hw_ptr trace rings (0 = disabled).");
+
+/* replace the trace ring of the substream; size 0 disables tracing */
+static int snd_pcm_trace_resize(struct snd_pcm_substream *substream,
+				unsigned int size)
+{
+	struct snd_pcm_trace *trace = NULL, *old;
+
+	if (size) {
+		size = roundup_pow_of_two(min_t(unsigned int, size,
+						SND_PCM_TRACE_MAX));
+		trace = vzalloc(sizeof(*trace) +
+				size * sizeof(struct snd_pcm_trace_entry));
+		if (!trace)
+			return -ENOMEM;
+		trace->size = size;
+	}
+
+	mutex_lock(&substream->trace_mutex);
+	snd_pcm_stream_lock_irq(substream);
+	old = substream->trace;
+	substream->trace = trace;
+	snd_pcm_stream_unlock_irq(substream);
+	mutex_unlock(&substream->trace_mutex);
+	vfree(old);
+	return 0;
+}
+
+static int snd_pcm_trace_open(struct snd_info_entry *entry,
+			      unsigned short mode, void **file_private_data)
+{
+	u64 *next;
+
+	next = kzalloc(sizeof(*next), GFP_KERNEL);
+	if (!next)
+		return -ENOMEM;
+	*file_private_data = next;
+	return 0;
+}
+
+static int snd_pcm_trace_release(struct snd_info_entry *entry,
+				 unsigned short mode, void *file_private_data)
+{
+	kfree(file_private_data);
+	return 0;
+}
+
+/*
+ * stream out the records following the last one read through this file;
+ * records already overwritten are skipped, which shows as a gap in seq
+ */
+static ssize_t snd_pcm_trace_read(struct snd_info_entry *entry,
+				  void *file_private_data, struct file *file,
+				  char __user *buf, size_t count, loff_t pos)
+{
+	struct snd_pcm_substream *substream = entry->private_data;
+	struct snd_pcm_trace_entry rec, *slot;
+	struct snd_pcm_trace *trace;
+	u64 *next = file_private_data;
+	u64 head, seq;
+	size_t copied = 0;
+
+	if (count < sizeof(rec))
+		return -EINVAL;
+
+	mutex_lock(&substream->trace_mutex);
+	trace = substream->trace;
+	if (!trace)
+		goto unlock;
+
+	snd_pcm_stream_lock_irq(substream);
+	head = trace->head;
+	snd_pcm_stream_unlock_irq(substream);
+
+	seq = *next;
+	if (seq > head || head - seq > trace->size)
+		seq = head > trace->size ? head - trace->size : 0;
+
+	for (; seq < head && count - copied >= sizeof(rec); seq++) {
+		slot = &trace->entries[seq & (trace->size - 1)];
+		if (ACCESS_ONCE(slot->seq) != seq)
+			continue;	/* overwritten meanwhile */
+		smp_rmb();
+		rec = *slot;
+		smp_rmb();
+		if (ACCESS_ONCE(slot->seq) != seq || rec.seq != seq)
+			continue;
+		if (copy_to_user(buf + copied, &rec, sizeof(rec))) {
+			if (!copied)
+				copied = -EFAULT;
+			break;
+		}
+		copied += sizeof(rec);
+	}
+	*next = seq;
+ unlock:
+	mutex_unlock(&substream->trace_mutex);
+	return copied;
+}
+
+static struct snd_info_entry_ops snd_pcm_trace_ops = {
+	.open = snd_pcm_trace_open,
+	.release = snd_pcm_trace_release,
+	.read = snd_pcm_trace_read,
+};
+
+static void snd_pcm_trace_size_read(struct snd_info_entry *entry,
+				    struct snd_info_buffer *buffer)
+{
+	struct snd_pcm_substream *substream = entry->private_data;
+
+	mutex_lock(&substream->trace_mutex);
+	snd_iprintf(buffer, "%u\n",
+		    substream->trace ? substream->trace->size : 0);
+	mutex_unlock(&substream->trace_mutex);
+}
+
+static void snd_pcm_trace_size_write(struct snd_info_entry *entry,
+				     struct snd_info_buffer *buffer)
+{
+	struct snd_pcm_substream *substream = entry->private_data;
+	char line[64];
+
+	if (!snd_info_get_line(buffer, line, sizeof(line)))
+		buffer->error = snd_pcm_trace_resize(substream,
+					simple_strtoul(line, NULL, 10));
+}
+
+static bool latency_hist;
+module_param(latency_hist, bool, 0444);
+MODULE_PARM_DESC(latency_hist, "Enable the PCM latency histograms by default.");
+
+static void snd_pcm_latency_read(struct snd_info_entry *entry,
+				 struct snd_info_buffer *buffer)
+{
+	struct snd_pcm_substream *substream = entry->private_data;
+	u32 hist[SND_PCM_LAT_NUM][SND_PCM_LAT_BUCKETS];
+	unsigned int i, enabled;
+	char range[24];
+
+	snd_pcm_stream_lock_irq(substream);
+	enabled = substream->latency.enabled;
+	memcpy(hist, substream->latency.hist, sizeof(hist));
+	snd_pcm_stream_unlock_irq(substream);
+
+	snd_iprintf(buffer, "enabled: %u\n", enabled);
+	snd_iprintf(buffer, "%-16s %12s %12s %12s\n", "usecs",
+		    "irq-hwptr", "hwptr-wakeup", "wakeup-xfer");
+	for (i = 0; i < SND_PCM_LAT_BUCKETS; i++) {
+		if (!i)
+			strcpy(range, "0");
+		else if (i == SND_PCM_LAT_BUCKETS - 1)
+			sprintf(range, "%u-", 1U << (i - 1));
+		else
+			sprintf(range, "%u-%u", 1U << (i - 1), (1U << i) - 1);
+		snd_iprintf(buffer, "%-16s %12u %12u %12u\n", range,
+			    hist[SND_PCM_LAT_IRQ_HWPTR][i],
+			    hist[SND_PCM_LAT_HWPTR_WAKEUP][i],
+			    hist[SND_PCM_LAT_WAKEUP_XFER][i]);
+	}
+}
+
+/* writing 0 or 1 disables or enables the histograms; both clear them */
+static void snd_pcm_latency_write(struct snd_info_entry *entry,
+				  struct snd_info_buffer *buffer)
+{
+	struct snd_pcm_substream *substream = entry->private_data;
+	char line[64];
+	int enable;
+
+	if (snd_info_get_line(buffer, line, sizeof(line)))
+		return;
+	enable = !!simple_strtoul(line, NULL, 10);
+	snd_pcm_stream_lock_irq(substream);
+	memset(&substream->latency, 0, sizeof(substream->latency));
+	substream->latency.enabled = enable;
+	snd_pcm_stream_unlock_irq(substream);
+}
+
+static bool callback_stats;
+module_param(callback_stats, bool, 0444);
+MODULE_PARM_DESC(callback_stats, "Enable the PCM driver callback accounting by default.");
+
+static void snd_pcm_callbacks_read(struct snd_info_entry *entry,
+				   struct snd_info_buffer *buffer)
+{
+	static const char * const names[SND_PCM_CB_NUM] = {
+		[SND_PCM_CB_POINTER] = "pointer",
+		[SND_PCM_CB_TRIGGER] = "trigger",
+		[SND_PCM_CB_COPY] = "copy",
+		[SND_PCM_CB_SILENCE] = "silence",
+		[SND_PCM_CB_PREPARE] = "prepare",
+	};
+	struct snd_pcm_substream *substream = entry->private_data;
+	struct snd_pcm_cb_stat stats[SND_PCM_CB_NUM];
+	unsigned int i;
+
+	memcpy(stats, substream->cb_stats, sizeof(stats));
+	snd_iprintf(buffer, "enabled: %u\n", substream->cb_stats_enabled);
+	snd_iprintf(buffer, "%-10s %12s %16s %12s\n",
+		    "callback", "count", "total_ns", "max_ns");
+	for (i = 0; i < SND_PCM_CB_NUM; i++)
+		snd_iprintf(buffer, "%-10s %12llu %16llu %12llu\n", names[i],
+			    (unsigned long long)stats[i].count,
+			    (unsigned long long)stats[i].total_ns,
+			    (unsigned long long)stats[i].max_ns);
+}
+
+/* writing 0 or 1 disables or enables the accounting; both clear it */
+static void snd_pcm_callbacks_write(struct snd_info_entry *entry,
+				    struct snd_info_buffer *buffer)
+{
+	struct snd_pcm_substream *substream = entry->private_data;
+	char line[64];
+
+	if (snd_info_get_line(buffer, line, sizeof(line)))
+		return;
+	snd_pcm_stream_lock_irq(substream);
+	substream->cb_stats_enabled = 0;
+	memset(substream->cb_stats, 0, sizeof(substream->cb_stats));
+	substream->cb_stats_enabled = !!simple_strtoul(line, NULL, 10);
+	snd_pcm_stream_unlock_irq(substream);
+}
+
 #ifdef CONFIG_SND_PCM_XRUN_DEBUG
 static void snd_pcm_xrun_debug_read(struct snd_info_entry *entry,
 				    struct snd_info_buffer *buffer)
@@ -604,6 +835,60 @@ static int snd_pcm_substream_proc_init(struct snd_pcm_substream *substream)
 	}
 	substream->proc_status_entry = entry;
 
+	mutex_init(&substream->trace_mutex);
+	if (trace_size > 0)
+		snd_pcm_trace_resize(substream, trace_size);
+
+	if ((entry = snd_info_create_card_entry(card, "trace", substream->proc_root)) != NULL) {
+		entry->content = SNDRV_INFO_CONTENT_DATA;
+		entry->private_data = substream;
+		entry->c.ops = &snd_pcm_trace_ops;
+		entry->size = LONG_MAX;
+		if (snd_info_register(entry) < 0) {
+			snd_info_free_entry(entry);
+			entry = NULL;
+		}
+	}
+	substream->proc_trace_entry = entry;
+
+	if ((entry = snd_info_create_card_entry(card, "trace_size", substream->proc_root)) != NULL) {
+		entry->c.text.read = snd_pcm_trace_size_read;
+		entry->c.text.write = snd_pcm_trace_size_write;
+		entry->mode |= S_IWUSR;
+		entry->private_data = substream;
+		if (snd_info_register(entry) < 0) {
+			snd_info_free_entry(entry);
+			entry = NULL;
+		}
+	}
+	substream->proc_trace_size_entry = entry;
+
+	substream->latency.enabled = latency_hist;
+	if ((entry = snd_info_create_card_entry(card, "latency", substream->proc_root)) != NULL) {
+		entry->c.text.read = snd_pcm_latency_read;
+		entry->c.text.write = snd_pcm_latency_write;
+		entry->mode |= S_IWUSR;
+		entry->private_data = substream;
+		if (snd_info_register(entry) < 0) {
+			snd_info_free_entry(entry);
+			entry = NULL;
+		}
+	}
+	substream->proc_latency_entry = entry;
+
+	substream->cb_stats_enabled = callback_stats;
+	if ((entry = snd_info_create_card_entry(card, "callbacks", substream->proc_root)) != NULL) {
+		entry->c.text.read = snd_pcm_callbacks_read;
+		entry->c.text.write = snd_pcm_callbacks_write;
+		entry->mode |= S_IWUSR;
+		entry->private_data = substream;
+		if (snd_info_register(entry) < 0) {
+			snd_info_free_entry(entry);
+			entry = NULL;
+		}
+	}
+	substream->proc_callbacks_entry = entry;
+
 	return 0;
 }
 
@@ -617,6 +902,16 @@ static int snd_pcm_substream_proc_done(struct snd_pcm_substream *substream)
 	substream->proc_sw_params_entry = NULL;
 	snd_info_free_entry(substream->proc_status_entry);
 	substream->proc_status_entry = NULL;
+	snd_info_free_entry(substream->proc_trace_entry);
+	substream->proc_trace_entry = NULL;
+	snd_info_free_entry(substream->proc_trace_size_entry);
+	substream->proc_trace_size_entry = NULL;
+	snd_info_free_entry(substream->proc_latency_entry);
+	substream->proc_latency_entry = NULL;
+	snd_info_free_entry(substream->proc_callbacks_entry);
+	substream->proc_callbacks_entry = NULL;
+	vfree(substream->trace);
+	substream->trace = NULL;
 	snd_info_free_entry(substream->proc_root);
 	substream->proc_root = NULL;
 	return 0;
@@ -695,6 +990,12 @@ int snd_pcm_new_stream(struct snd_pcm *pcm, int stream, int substream_count)
 		INIT_LIST_HEAD(&substream->self_group.substreams);
 		list_add_tail(&substream->link_list, &substream->self_group.substreams);
 		atomic_set(&substream->mmap_count, 0);
+		hrtimer_init(&substream->wakeup_timer, CLOCK_MONOTONIC,
+			     HRTIMER_MODE_REL);
+		substream->wakeup_timer.function = snd_pcm_wakeup_timer_func;
+		hrtimer_init(&substream->timer_interp, CLOCK_MONOTONIC,
+			     HRTIMER_MODE_REL);
+		substream->timer_interp.function = snd_pcm_timer_interp_func;
 		prev = substream;
 	}
 	return 0;
@@ -975,6 +1276,8 @@ void snd_pcm_detach_substream(struct snd_pcm_substream *substream)
 	if (PCM_RUNTIME_CHECK(substream))
 		return;
 	runtime = substream->runtime;
+	hrtimer_cancel(&substream->wakeup_timer);
+	hrtimer_cancel(&substream->timer_interp);
 	if (runtime->private_free != NULL)
 		runtime->private_free(runtime);
 	snd_free_pages((void*)runtime->status,
@@ -982,6 +1285,7 @@ void snd_pcm_detach_substream(struct snd_pcm_substream *substream)
 	snd_free_pages((void*)runtime->control,
 		       PAGE_ALIGN(sizeof(struct snd_pcm_mmap_control)));
 	kfree(runtime->hw_constraints.rules);
+	kfree(runtime->hw_constraints.dependents);
 #ifdef CONFIG_SND_PCM_XRUN_DEBUG
 	kfree(runtime->hwptr_log);
 #endif
@@ -1211,6 +1515,7 @@ static int __init alsa_pcm_init(void)
 	snd_ctl_register_ioctl(snd_pcm_control_ioctl);
 	snd_ctl_register_ioctl_compat(snd_pcm_control_ioctl);
 	snd_pcm_proc_init();
+	snd_pcm_dma_pool_init();
 	return 0;
 }
 
@@ -1218,6 +1523,7 @@ static void __exit alsa_pcm_exit(void)
 {
 	snd_ctl_unregister_ioctl(snd_pcm_control_ioctl);
 	snd_ctl_unregister_ioctl_compat(snd_pcm_control_ioctl);
+	snd_pcm_dma_pool_done();
 	snd_pcm_proc_done();
 }
 
@@ -300,6 +300,64 @@ static int snd_pcm_ioctl_xferi_compat(struct snd_pcm_substream *substream,
 	return 0;
 }
 
+/* snd_xferi_vec needs remapping of buf */
+struct snd_xferi_vec32 {
+	s32 result;
+	u32 buf;
+	u32 frames;
+	s32 fd;
+	u32 reserved;
+};
+
+struct snd_xferi_multi32 {
+	u32 count;
+	u32 reserved;
+	u32 vec;
+};
+
+static int snd_pcm_ioctl_xferi_multi_compat(struct snd_pcm_substream *substream,
+					    int dir,
+					    struct snd_xferi_multi32 __user *data32)
+{
+	struct snd_xferi_vec32 __user *vec32;
+	struct snd_xferi_vec32 v32;
+	struct snd_xferi_vec *vec;
+	u32 count, ptr;
+	unsigned int i;
+	int err;
+
+	if (substream->stream != dir)
+		return -EINVAL;
+	if (get_user(count, &data32->count) ||
+	    get_user(ptr, &data32->vec))
+		return -EFAULT;
+	if (!count || count > SNDRV_PCM_XFER_MULTI_MAX)
+		return -EINVAL;
+	vec32 = compat_ptr(ptr);
+	vec = kcalloc(count, sizeof(*vec), GFP_KERNEL);
+	if (!vec)
+		return -ENOMEM;
+	for (i = 0; i < count; i++) {
+		if (copy_from_user(&v32, &vec32[i], sizeof(v32))) {
+			err = -EFAULT;
+			goto error;
+		}
+		vec[i].buf = compat_ptr(v32.buf);
+		vec[i].frames = v32.frames;
+		vec[i].fd = v32.fd;
+	}
+	err = snd_pcm_xferi_multi_vec(substream, vec, count);
+	for (i = 0; i < count; i++) {
+		if (put_user(vec[i].result, &vec32[i].result)) {
+			err = -EFAULT;
+			break;
+		}
+	}
+ error:
+	kfree(vec);
+	return err;
+}
+
 
 /* snd_xfern needs remapping of bufs */
 struct snd_xfern32 {
@@ -459,6 +517,8 @@ enum {
 	SNDRV_PCM_IOCTL_READI_FRAMES32 = _IOR('A', 0x51, struct snd_xferi32),
 	SNDRV_PCM_IOCTL_WRITEN_FRAMES32 = _IOW('A', 0x52, struct snd_xfern32),
 	SNDRV_PCM_IOCTL_READN_FRAMES32 = _IOR('A', 0x53, struct snd_xfern32),
+	SNDRV_PCM_IOCTL_WRITEI_MULTI32 = _IOW('A', 0x54, struct snd_xferi_multi32),
+	SNDRV_PCM_IOCTL_READI_MULTI32 = _IOR('A', 0x55, struct snd_xferi_multi32),
 	SNDRV_PCM_IOCTL_SYNC_PTR32 = _IOWR('A', 0x23, struct snd_pcm_sync_ptr32),
 
 };
@@ -524,6 +584,10 @@ static long snd_pcm_ioctl_compat(struct file *file, unsigned int cmd, unsigned l
 		return snd_pcm_ioctl_xfern_compat(substream, SNDRV_PCM_STREAM_PLAYBACK, argp);
 	case SNDRV_PCM_IOCTL_READN_FRAMES32:
 		return snd_pcm_ioctl_xfern_compat(substream, SNDRV_PCM_STREAM_CAPTURE, argp);
+	case SNDRV_PCM_IOCTL_WRITEI_MULTI32:
+		return snd_pcm_ioctl_xferi_multi_compat(substream, SNDRV_PCM_STREAM_PLAYBACK, argp);
+	case SNDRV_PCM_IOCTL_READI_MULTI32:
+		return snd_pcm_ioctl_xferi_multi_compat(substream, SNDRV_PCM_STREAM_CAPTURE, argp);
 	case SNDRV_PCM_IOCTL_DELAY32:
 		return snd_pcm_ioctl_delay_compat(substream, argp);
 	case SNDRV_PCM_IOCTL_REWIND32:
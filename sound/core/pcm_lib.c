@@ -23,6 +23,7 @@
 #include <linux/slab.h>
 #include <linux/time.h>
 #include <linux/math64.h>
+#include <linux/log2.h>
 #include <linux/export.h>
 #include <sound/core.h>
 #include <sound/control.h>
@@ -101,7 +102,7 @@ void snd_pcm_playback_silence(struct snd_pcm_substream *substream, snd_pcm_ufram
 		    runtime->access == SNDRV_PCM_ACCESS_MMAP_INTERLEAVED) {
 			if (substream->ops->silence) {
 				int err;
-				err = substream->ops->silence(substream, -1, ofs, transfer);
+				err = snd_pcm_ops_silence(substream, -1, ofs, transfer);
 				snd_BUG_ON(err < 0);
 			} else {
 				char *hwbuf = runtime->dma_area + frames_to_bytes(runtime, ofs);
@@ -113,7 +114,7 @@ void snd_pcm_playback_silence(struct snd_pcm_substream *substream, snd_pcm_ufram
 			if (substream->ops->silence) {
 				for (c = 0; c < channels; ++c) {
 					int err;
-					err = substream->ops->silence(substream, c, ofs, transfer);
+					err = snd_pcm_ops_silence(substream, c, ofs, transfer);
 					snd_BUG_ON(err < 0);
 				}
 			} else {
@@ -164,12 +165,123 @@ EXPORT_SYMBOL(snd_pcm_debug_name);
 			dump_stack();				\
 	} while (0)
 
+#ifdef CONFIG_SND_VERBOSE_PROCFS
+/* record a hw_ptr update in the trace ring; call with the stream lock held */
+static void pcm_trace(struct snd_pcm_substream *substream, unsigned int reason,
+		      snd_pcm_uframes_t pos, snd_pcm_uframes_t hw_ptr,
+		      unsigned int in_interrupt)
+{
+	struct snd_pcm_trace *trace = substream->trace;
+	struct snd_pcm_runtime *runtime = substream->runtime;
+	struct snd_pcm_trace_entry *entry;
+	snd_pcm_sframes_t avail;
+	u64 seq;
+
+	if (likely(!trace))
+		return;
+
+	avail = hw_ptr - runtime->control->appl_ptr;
+	if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK)
+		avail += runtime->buffer_size;
+	if (avail < 0)
+		avail += runtime->boundary;
+	else if ((snd_pcm_uframes_t)avail >= runtime->boundary)
+		avail -= runtime->boundary;
+
+	seq = trace->head;
+	entry = &trace->entries[seq & (trace->size - 1)];
+	/* invalidate the slot while it is rewritten */
+	entry->seq = ~0ULL;
+	smp_wmb();
+	entry->tstamp_ns = ktime_to_ns(ktime_get());
+	entry->pos = pos;
+	entry->hw_ptr = hw_ptr;
+	entry->appl_ptr = runtime->control->appl_ptr;
+	entry->avail = avail;
+	entry->reason = reason;
+	entry->in_interrupt = in_interrupt;
+	smp_wmb();
+	entry->seq = seq;
+	trace->head = seq + 1;
+}
+
+/* latency histograms; all but pcm_latency_now() need the stream lock */
+static inline u64 pcm_latency_now(struct snd_pcm_substream *substream)
+{
+	if (likely(!substream->latency.enabled))
+		return 0;
+	return ktime_to_ns(ktime_get());
+}
+
+static void pcm_latency_add(struct snd_pcm_substream *substream,
+			    unsigned int type, u64 start, u64 end)
+{
+	u64 usecs = div_u64(end - start, 1000);
+	unsigned int bucket = 0;
+
+	if (usecs)
+		bucket = min_t(unsigned int, ilog2(usecs) + 1,
+			       SND_PCM_LAT_BUCKETS - 1);
+	substream->latency.hist[type][bucket]++;
+}
+
+/* hw_ptr was updated from snd_pcm_period_elapsed() entered at irq_ns */
+static void pcm_latency_hw_ptr(struct snd_pcm_substream *substream, u64 irq_ns)
+{
+	struct snd_pcm_latency *lat = &substream->latency;
+	u64 now;
+
+	if (!lat->enabled || !irq_ns)
+		return;
+	now = ktime_to_ns(ktime_get());
+	pcm_latency_add(substream, SND_PCM_LAT_IRQ_HWPTR, irq_ns, now);
+	lat->hw_ptr_ns = now;
+}
+
+/* a transfer went to sleep at sleep_ns and runs again */
+static void pcm_latency_wakeup(struct snd_pcm_substream *substream,
+			       u64 sleep_ns)
+{
+	struct snd_pcm_latency *lat = &substream->latency;
+	u64 now;
+
+	if (!lat->enabled || !sleep_ns || lat->hw_ptr_ns <= sleep_ns)
+		return;	/* not woken by a period update */
+	now = ktime_to_ns(ktime_get());
+	pcm_latency_add(substream, SND_PCM_LAT_HWPTR_WAKEUP,
+			lat->hw_ptr_ns, now);
+	lat->wakeup_ns = now;
+}
+
+/* appl_ptr was moved by the transfer */
+static void pcm_latency_xfer(struct snd_pcm_substream *substream)
+{
+	struct snd_pcm_latency *lat = &substream->latency;
+
+	if (!lat->enabled || !lat->wakeup_ns)
+		return;
+	pcm_latency_add(substream, SND_PCM_LAT_WAKEUP_XFER, lat->wakeup_ns,
+			ktime_to_ns(ktime_get()));
+	lat->wakeup_ns = 0;
+}
+#else
+#define pcm_trace(substream, reason, pos, hw_ptr, in_interrupt) do { } while (0)
+#define pcm_latency_now(substream)		0
+#define pcm_latency_hw_ptr(substream, irq_ns)	do { } while (0)
+#define pcm_latency_wakeup(substream, sleep_ns)	do { } while (0)
+#define pcm_latency_xfer(substream)		do { } while (0)
+#endif
+
 static void xrun(struct snd_pcm_substream *substream)
 {
 	struct snd_pcm_runtime *runtime = substream->runtime;
 
-	if (runtime->tstamp_mode == SNDRV_PCM_TSTAMP_ENABLE)
+	pcm_trace(substream, SNDRV_PCM_TRACE_XRUN, -1, runtime->status->hw_ptr, 0);
+	if (runtime->tstamp_mode == SNDRV_PCM_TSTAMP_ENABLE) {
+		snd_pcm_status_write_begin(runtime);
 		snd_pcm_gettime(runtime, (struct timespec *)&runtime->status->tstamp);
+		snd_pcm_status_write_end(runtime);
+	}
 	snd_pcm_stop(substream, SNDRV_PCM_STATE_XRUN);
 	if (xrun_debug(substream, XRUN_DEBUG_BASIC)) {
 		char name[16];
@@ -306,6 +418,18 @@ int snd_pcm_update_state(struct snd_pcm_substream *substream,
 	return 0;
 }
 
+/*
+ * (frames * mult) >> 32 for the 32.32 fixed point multipliers set up in
+ * snd_pcm_hw_params(), without a 64bit division or overflowing product
+ */
+static inline u64 pcm_frames_mul(u64 frames, u64 mult)
+{
+	u32 lo = frames, hi = frames >> 32;
+
+	return (u64)lo * (u32)(mult >> 32) + (((u64)lo * (u32)mult) >> 32) +
+		(u64)hi * mult;
+}
+
 static int snd_pcm_update_hw_ptr0(struct snd_pcm_substream *substream,
 				  unsigned int in_interrupt)
 {
@@ -327,7 +451,7 @@ static int snd_pcm_update_hw_ptr0(struct snd_pcm_substream *substream,
 	 * The values are stored at the end of this routine after
 	 * corrections for hw_ptr position
 	 */
-	pos = substream->ops->pointer(substream);
+	pos = snd_pcm_ops_pointer(substream);
 	curr_jiffies = jiffies;
 	if (runtime->tstamp_mode == SNDRV_PCM_TSTAMP_ENABLE) {
 		snd_pcm_gettime(runtime, (struct timespec *)&curr_tstamp);
@@ -351,9 +475,11 @@ static int snd_pcm_update_hw_ptr0(struct snd_pcm_substream *substream,
 				   name, pos, runtime->buffer_size,
 				   runtime->period_size);
 		}
+		pcm_trace(substream, SNDRV_PCM_TRACE_BADPOS, pos, old_hw_ptr,
+			  in_interrupt);
 		pos = 0;
 	}
-	pos -= pos % runtime->min_align;
+	pos &= ~(runtime->min_align - 1);
 	if (xrun_debug(substream, XRUN_DEBUG_LOG))
 		xrun_log(substream, pos, in_interrupt);
 	hw_base = runtime->hw_ptr_base;
@@ -416,7 +542,8 @@ static int snd_pcm_update_hw_ptr0(struct snd_pcm_substream *substream,
 		jdelta = curr_jiffies - runtime->hw_ptr_jiffies;
 		if (jdelta < runtime->hw_ptr_buffer_jiffies / 2)
 			goto no_delta_check;
-		hdelta = jdelta - delta * HZ / runtime->rate;
+		hdelta = jdelta - pcm_frames_mul(delta,
+						 runtime->frame_jiffies_mult);
 		xrun_threshold = runtime->hw_ptr_buffer_jiffies / 2 + 1;
 		while (hdelta > xrun_threshold) {
 			delta += runtime->buffer_size;
@@ -440,6 +567,8 @@ static int snd_pcm_update_hw_ptr0(struct snd_pcm_substream *substream,
 				     in_interrupt ? "[Q] " : "[P]",
 				     substream->stream, (long)pos,
 				     (long)new_hw_ptr, (long)old_hw_ptr);
+		pcm_trace(substream, SNDRV_PCM_TRACE_BADDELTA, pos, old_hw_ptr,
+			  in_interrupt);
 		return 0;
 	}
 
@@ -503,6 +632,9 @@ static int snd_pcm_update_hw_ptr0(struct snd_pcm_substream *substream,
 	}
 
  no_delta_check:
+	pcm_trace(substream, in_interrupt ?
+		  SNDRV_PCM_TRACE_PERIOD : SNDRV_PCM_TRACE_HWPTR,
+		  pos, new_hw_ptr, in_interrupt);
 	if (runtime->status->hw_ptr == new_hw_ptr)
 		return 0;
 
@@ -514,14 +646,23 @@ static int snd_pcm_update_hw_ptr0(struct snd_pcm_substream *substream,
 		delta = new_hw_ptr - runtime->hw_ptr_interrupt;
 		if (delta < 0)
 			delta += runtime->boundary;
-		delta -= (snd_pcm_uframes_t)delta % runtime->period_size;
+		/* usually exactly one period has elapsed */
+		if (delta < runtime->period_size)
+			delta = 0;
+		else if (delta < 2 * runtime->period_size)
+			delta = runtime->period_size;
+		else
+			delta -= (snd_pcm_uframes_t)delta % runtime->period_size;
 		runtime->hw_ptr_interrupt += delta;
 		if (runtime->hw_ptr_interrupt >= runtime->boundary)
 			runtime->hw_ptr_interrupt -= runtime->boundary;
 	}
 	runtime->hw_ptr_base = hw_base;
+	snd_pcm_status_write_begin(runtime);
 	runtime->status->hw_ptr = new_hw_ptr;
 	runtime->hw_ptr_jiffies = curr_jiffies;
+	if (runtime->timer_wakeup || substream->timer_sub_running)
+		runtime->hw_ptr_ns = ktime_to_ns(ktime_get());
 	if (crossed_boundary) {
 		snd_BUG_ON(crossed_boundary != 1);
 		runtime->hw_ptr_wrap += runtime->boundary;
@@ -544,12 +685,13 @@ static int snd_pcm_update_hw_ptr0(struct snd_pcm_substream *substream,
 				audio_frames = runtime->hw_ptr_wrap
 					+ runtime->status->hw_ptr
 					+ runtime->delay;
-			audio_nsecs = div_u64(audio_frames * 1000000000LL,
-					runtime->rate);
+			audio_nsecs = pcm_frames_mul(audio_frames,
+						     runtime->frame_ns_mult);
 			audio_tstamp = ns_to_timespec(audio_nsecs);
 		}
 		runtime->status->audio_tstamp = audio_tstamp;
 	}
+	snd_pcm_status_write_end(runtime);
 
 	return snd_pcm_update_state(substream, runtime);
 }
@@ -560,6 +702,68 @@ int snd_pcm_update_hw_ptr(struct snd_pcm_substream *substream)
 	return snd_pcm_update_hw_ptr0(substream, 0);
 }
 
+/* don't poll the hardware pointer more often than this when waiting */
+#define WAKEUP_TIMER_MIN_NS	200000
+
+/*
+ * Timer wakeup mode: instead of relying on period interrupts, arm an
+ * hrtimer for the moment the wakeup threshold is expected to be reached,
+ * extrapolated from the last hw_ptr change and the rate.
+ * Call with the stream lock held.
+ */
+void snd_pcm_wakeup_timer_arm(struct snd_pcm_substream *substream)
+{
+	struct snd_pcm_runtime *runtime = substream->runtime;
+	snd_pcm_uframes_t avail, target;
+	s64 delay, elapsed;
+
+	if (!runtime->timer_wakeup || !runtime->rate ||
+	    runtime->status->state != SNDRV_PCM_STATE_RUNNING)
+		return;
+
+	if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK)
+		avail = snd_pcm_playback_avail(runtime);
+	else
+		avail = snd_pcm_capture_avail(runtime);
+	/* a blocked read/write waits for twake, poll() for avail_min */
+	target = runtime->twake ? runtime->twake : runtime->control->avail_min;
+	if (avail >= target)
+		return;
+
+	delay = pcm_frames_mul(target - avail, runtime->frame_ns_mult);
+	elapsed = ktime_to_ns(ktime_get()) - runtime->hw_ptr_ns;
+	if (elapsed > 0 && runtime->hw_ptr_ns)
+		delay -= elapsed;
+	if (delay < WAKEUP_TIMER_MIN_NS)
+		delay = WAKEUP_TIMER_MIN_NS;
+
+	/* an earlier expiry already pending is good enough */
+	if (hrtimer_is_queued(&substream->wakeup_timer) &&
+	    ktime_to_ns(hrtimer_get_remaining(&substream->wakeup_timer)) <= delay)
+		return;
+	hrtimer_start(&substream->wakeup_timer, ns_to_ktime(delay),
+		      HRTIMER_MODE_REL);
+}
+
+enum hrtimer_restart snd_pcm_wakeup_timer_func(struct hrtimer *timer)
+{
+	struct snd_pcm_substream *substream =
+		container_of(timer, struct snd_pcm_substream, wakeup_timer);
+	struct snd_pcm_runtime *runtime;
+	unsigned long flags;
+
+	snd_pcm_stream_lock_irqsave(substream, flags);
+	runtime = substream->runtime;
+	if (runtime && snd_pcm_running(substream) &&
+	    snd_pcm_update_hw_ptr(substream) >= 0 &&
+	    (waitqueue_active(&runtime->sleep) ||
+	     waitqueue_active(&runtime->tsleep)))
+		/* not there yet, someone is still waiting */
+		snd_pcm_wakeup_timer_arm(substream);
+	snd_pcm_stream_unlock_irqrestore(substream, flags);
+	return HRTIMER_NORESTART;
+}
+
 /**
  * snd_pcm_set_ops - set the PCM operators
  * @pcm: the pcm instance
@@ -1161,9 +1365,16 @@ int snd_pcm_hw_rule_add(struct snd_pcm_runtime *runtime, unsigned int cond,
 	va_start(args, dep);
 	if (constrs->rules_num >= constrs->rules_all) {
 		struct snd_pcm_hw_rule *new;
+		unsigned long *deps;
 		unsigned int new_rules = constrs->rules_all + 16;
+		unsigned int old_longs = BITS_TO_LONGS(constrs->rules_all);
+		unsigned int new_longs = BITS_TO_LONGS(new_rules);
 		new = kcalloc(new_rules, sizeof(*c), GFP_KERNEL);
-		if (!new) {
+		deps = kcalloc((SNDRV_PCM_HW_PARAM_LAST_INTERVAL + 1) *
+			       new_longs, sizeof(*deps), GFP_KERNEL);
+		if (!new || !deps) {
+			kfree(new);
+			kfree(deps);
 			va_end(args);
 			return -ENOMEM;
 		}
@@ -1172,7 +1383,15 @@ int snd_pcm_hw_rule_add(struct snd_pcm_runtime *runtime, unsigned int cond,
 			       constrs->rules_num * sizeof(*c));
 			kfree(constrs->rules);
 		}
+		if (constrs->dependents) {
+			for (k = 0; k <= SNDRV_PCM_HW_PARAM_LAST_INTERVAL; k++)
+				memcpy(deps + k * new_longs,
+				       constrs->dependents + k * old_longs,
+				       old_longs * sizeof(*deps));
+			kfree(constrs->dependents);
+		}
 		constrs->rules = new;
+		constrs->dependents = deps;
 		constrs->rules_all = new_rules;
 	}
 	c = &constrs->rules[constrs->rules_num];
@@ -1180,6 +1399,7 @@ int snd_pcm_hw_rule_add(struct snd_pcm_runtime *runtime, unsigned int cond,
 	c->func = func;
 	c->var = var;
 	c->private = private;
+	c->dep_mask = 0;
 	k = 0;
 	while (1) {
 		if (snd_BUG_ON(k >= ARRAY_SIZE(c->deps))) {
@@ -1189,8 +1409,17 @@ int snd_pcm_hw_rule_add(struct snd_pcm_runtime *runtime, unsigned int cond,
 		c->deps[k++] = dep;
 		if (dep < 0)
 			break;
+		if (snd_BUG_ON(dep > SNDRV_PCM_HW_PARAM_LAST_INTERVAL)) {
+			va_end(args);
+			return -EINVAL;
+		}
+		c->dep_mask |= 1U << dep;
 		dep = va_arg(args, int);
 	}
+	for (k = 0; k <= SNDRV_PCM_HW_PARAM_LAST_INTERVAL; k++)
+		if (c->dep_mask & (1U << k))
+			__set_bit(constrs->rules_num,
+				  constrs_dependents(constrs, k));
 	constrs->rules_num++;
 	va_end(args);
 	return 0;
@@ -1733,10 +1962,14 @@ static int snd_pcm_lib_ioctl_reset(struct snd_pcm_substream *substream,
 	unsigned long flags;
 	snd_pcm_stream_lock_irqsave(substream, flags);
 	if (snd_pcm_running(substream) &&
-	    snd_pcm_update_hw_ptr(substream) >= 0)
+	    snd_pcm_update_hw_ptr(substream) >= 0) {
+		snd_pcm_status_write_begin(runtime);
 		runtime->status->hw_ptr %= runtime->buffer_size;
-	else {
+		snd_pcm_status_write_end(runtime);
+	} else {
+		snd_pcm_status_write_begin(runtime);
 		runtime->status->hw_ptr = 0;
+		snd_pcm_status_write_end(runtime);
 		runtime->hw_ptr_wrap = 0;
 	}
 	snd_pcm_stream_unlock_irqrestore(substream, flags);
@@ -1839,10 +2072,12 @@ void snd_pcm_period_elapsed(struct snd_pcm_substream *substream)
 {
 	struct snd_pcm_runtime *runtime;
 	unsigned long flags;
+	u64 irq_ns;
 
 	if (PCM_RUNTIME_CHECK(substream))
 		return;
 	runtime = substream->runtime;
+	irq_ns = pcm_latency_now(substream);
 
 	if (runtime->transfer_ack_begin)
 		runtime->transfer_ack_begin(substream);
@@ -1851,9 +2086,10 @@ void snd_pcm_period_elapsed(struct snd_pcm_substream *substream)
 	if (!snd_pcm_running(substream) ||
 	    snd_pcm_update_hw_ptr0(substream, 1) < 0)
 		goto _end;
+	pcm_latency_hw_ptr(substream, irq_ns);
 
-	if (substream->timer_running)
-		snd_timer_interrupt(substream->timer, 1);
+	if (substream->timer_running || substream->timer_sub_running)
+		snd_pcm_timer_period_elapsed(substream);
  _end:
 	snd_pcm_stream_unlock_irqrestore(substream, flags);
 	if (runtime->transfer_ack_end)
@@ -1878,6 +2114,7 @@ static int wait_for_avail(struct snd_pcm_substream *substream,
 	int err = 0;
 	snd_pcm_uframes_t avail = 0;
 	long wait_time, tout;
+	u64 sleep_ns;
 
 	init_waitqueue_entry(&wait, current);
 	set_current_state(TASK_INTERRUPTIBLE);
@@ -1913,11 +2150,14 @@ static int wait_for_avail(struct snd_pcm_substream *substream,
 			avail = snd_pcm_capture_avail(runtime);
 		if (avail >= runtime->twake)
 			break;
+		snd_pcm_wakeup_timer_arm(substream);
+		sleep_ns = pcm_latency_now(substream);
 		snd_pcm_stream_unlock_irq(substream);
 
 		tout = schedule_timeout(wait_time);
 
 		snd_pcm_stream_lock_irq(substream);
+		pcm_latency_wakeup(substream, sleep_ns);
 		set_current_state(TASK_INTERRUPTIBLE);
 		switch (runtime->status->state) {
 		case SNDRV_PCM_STATE_SUSPENDED:
@@ -1961,7 +2201,7 @@ static int snd_pcm_lib_write_transfer(struct snd_pcm_substream *substream,
 	int err;
 	char __user *buf = (char __user *) data + frames_to_bytes(runtime, off);
 	if (substream->ops->copy) {
-		if ((err = substream->ops->copy(substream, -1, hwoff, buf, frames)) < 0)
+		if ((err = snd_pcm_ops_copy(substream, -1, hwoff, buf, frames)) < 0)
 			return err;
 	} else {
 		char *hwbuf = runtime->dma_area + frames_to_bytes(runtime, hwoff);
@@ -1978,7 +2218,7 @@ typedef int (*transfer_f)(struct snd_pcm_substream *substream, unsigned int hwof
 static snd_pcm_sframes_t snd_pcm_lib_write1(struct snd_pcm_substream *substream, 
 					    unsigned long data,
 					    snd_pcm_uframes_t size,
-					    int nonblock,
+					    int nonblock, int hwsync,
 					    transfer_f transfer)
 {
 	struct snd_pcm_runtime *runtime = substream->runtime;
@@ -2008,7 +2248,7 @@ static snd_pcm_sframes_t snd_pcm_lib_write1(struct snd_pcm_substream *substream,
 	}
 
 	runtime->twake = runtime->control->avail_min ? : 1;
-	if (runtime->status->state == SNDRV_PCM_STATE_RUNNING)
+	if (hwsync && runtime->status->state == SNDRV_PCM_STATE_RUNNING)
 		snd_pcm_update_hw_ptr(substream);
 	avail = snd_pcm_playback_avail(runtime);
 	while (size > 0) {
@@ -2055,6 +2295,7 @@ static snd_pcm_sframes_t snd_pcm_lib_write1(struct snd_pcm_substream *substream,
 		if (appl_ptr >= runtime->boundary)
 			appl_ptr -= runtime->boundary;
 		runtime->control->appl_ptr = appl_ptr;
+		pcm_latency_xfer(substream);
 		if (substream->ops->ack)
 			substream->ops->ack(substream);
 
@@ -2091,7 +2332,13 @@ static int pcm_sanity_check(struct snd_pcm_substream *substream)
 	return 0;
 }
 
-snd_pcm_sframes_t snd_pcm_lib_write(struct snd_pcm_substream *substream, const void __user *buf, snd_pcm_uframes_t size)
+/*
+ * with hwsync = 0, the caller has refreshed hw_ptr already, see
+ * snd_pcm_xferi_multi()
+ */
+snd_pcm_sframes_t __snd_pcm_lib_write(struct snd_pcm_substream *substream,
+				      const void __user *buf,
+				      snd_pcm_uframes_t size, int hwsync)
 {
 	struct snd_pcm_runtime *runtime;
 	int nonblock;
@@ -2107,7 +2354,12 @@ snd_pcm_sframes_t snd_pcm_lib_write(struct snd_pcm_substream *substream, const v
 	    runtime->channels > 1)
 		return -EINVAL;
 	return snd_pcm_lib_write1(substream, (unsigned long)buf, size, nonblock,
-				  snd_pcm_lib_write_transfer);
+				  hwsync, snd_pcm_lib_write_transfer);
+}
+
+snd_pcm_sframes_t snd_pcm_lib_write(struct snd_pcm_substream *substream, const void __user *buf, snd_pcm_uframes_t size)
+{
+	return __snd_pcm_lib_write(substream, buf, size, 1);
 }
 
 EXPORT_SYMBOL(snd_pcm_lib_write);
@@ -2127,11 +2379,11 @@ static int snd_pcm_lib_writev_transfer(struct snd_pcm_substream *substream,
 			return -EINVAL;
 		for (c = 0; c < channels; ++c, ++bufs) {
 			if (*bufs == NULL) {
-				if ((err = substream->ops->silence(substream, c, hwoff, frames)) < 0)
+				if ((err = snd_pcm_ops_silence(substream, c, hwoff, frames)) < 0)
 					return err;
 			} else {
 				char __user *buf = *bufs + samples_to_bytes(runtime, off);
-				if ((err = substream->ops->copy(substream, c, hwoff, buf, frames)) < 0)
+				if ((err = snd_pcm_ops_copy(substream, c, hwoff, buf, frames)) < 0)
 					return err;
 			}
 		}
@@ -2169,7 +2421,7 @@ snd_pcm_sframes_t snd_pcm_lib_writev(struct snd_pcm_substream *substream,
 	if (runtime->access != SNDRV_PCM_ACCESS_RW_NONINTERLEAVED)
 		return -EINVAL;
 	return snd_pcm_lib_write1(substream, (unsigned long)bufs, frames,
-				  nonblock, snd_pcm_lib_writev_transfer);
+				  nonblock, 1, snd_pcm_lib_writev_transfer);
 }
 
 EXPORT_SYMBOL(snd_pcm_lib_writev);
@@ -2183,7 +2435,7 @@ static int snd_pcm_lib_read_transfer(struct snd_pcm_substream *substream,
 	int err;
 	char __user *buf = (char __user *) data + frames_to_bytes(runtime, off);
 	if (substream->ops->copy) {
-		if ((err = substream->ops->copy(substream, -1, hwoff, buf, frames)) < 0)
+		if ((err = snd_pcm_ops_copy(substream, -1, hwoff, buf, frames)) < 0)
 			return err;
 	} else {
 		char *hwbuf = runtime->dma_area + frames_to_bytes(runtime, hwoff);
@@ -2196,7 +2448,7 @@ static int snd_pcm_lib_read_transfer(struct snd_pcm_substream *substream,
 static snd_pcm_sframes_t snd_pcm_lib_read1(struct snd_pcm_substream *substream,
 					   unsigned long data,
 					   snd_pcm_uframes_t size,
-					   int nonblock,
+					   int nonblock, int hwsync,
 					   transfer_f transfer)
 {
 	struct snd_pcm_runtime *runtime = substream->runtime;
@@ -2233,7 +2485,7 @@ static snd_pcm_sframes_t snd_pcm_lib_read1(struct snd_pcm_substream *substream,
 	}
 
 	runtime->twake = runtime->control->avail_min ? : 1;
-	if (runtime->status->state == SNDRV_PCM_STATE_RUNNING)
+	if (hwsync && runtime->status->state == SNDRV_PCM_STATE_RUNNING)
 		snd_pcm_update_hw_ptr(substream);
 	avail = snd_pcm_capture_avail(runtime);
 	while (size > 0) {
@@ -2287,6 +2539,7 @@ static snd_pcm_sframes_t snd_pcm_lib_read1(struct snd_pcm_substream *substream,
 		if (appl_ptr >= runtime->boundary)
 			appl_ptr -= runtime->boundary;
 		runtime->control->appl_ptr = appl_ptr;
+		pcm_latency_xfer(substream);
 		if (substream->ops->ack)
 			substream->ops->ack(substream);
 
@@ -2303,7 +2556,9 @@ static snd_pcm_sframes_t snd_pcm_lib_read1(struct snd_pcm_substream *substream,
 	return xfer > 0 ? (snd_pcm_sframes_t)xfer : err;
 }
 
-snd_pcm_sframes_t snd_pcm_lib_read(struct snd_pcm_substream *substream, void __user *buf, snd_pcm_uframes_t size)
+snd_pcm_sframes_t __snd_pcm_lib_read(struct snd_pcm_substream *substream,
+				     void __user *buf, snd_pcm_uframes_t size,
+				     int hwsync)
 {
 	struct snd_pcm_runtime *runtime;
 	int nonblock;
@@ -2316,7 +2571,12 @@ snd_pcm_sframes_t snd_pcm_lib_read(struct snd_pcm_substream *substream, void __u
 	nonblock = !!(substream->f_flags & O_NONBLOCK);
 	if (runtime->access != SNDRV_PCM_ACCESS_RW_INTERLEAVED)
 		return -EINVAL;
-	return snd_pcm_lib_read1(substream, (unsigned long)buf, size, nonblock, snd_pcm_lib_read_transfer);
+	return snd_pcm_lib_read1(substream, (unsigned long)buf, size, nonblock, hwsync, snd_pcm_lib_read_transfer);
+}
+
+snd_pcm_sframes_t snd_pcm_lib_read(struct snd_pcm_substream *substream, void __user *buf, snd_pcm_uframes_t size)
+{
+	return __snd_pcm_lib_read(substream, buf, size, 1);
 }
 
 EXPORT_SYMBOL(snd_pcm_lib_read);
@@ -2337,7 +2597,7 @@ static int snd_pcm_lib_readv_transfer(struct snd_pcm_substream *substream,
 			if (*bufs == NULL)
 				continue;
 			buf = *bufs + samples_to_bytes(runtime, off);
-			if ((err = substream->ops->copy(substream, c, hwoff, buf, frames)) < 0)
+			if ((err = snd_pcm_ops_copy(substream, c, hwoff, buf, frames)) < 0)
 				return err;
 		}
 	} else {
@@ -2375,7 +2635,7 @@ snd_pcm_sframes_t snd_pcm_lib_readv(struct snd_pcm_substream *substream,
 	nonblock = !!(substream->f_flags & O_NONBLOCK);
 	if (runtime->access != SNDRV_PCM_ACCESS_RW_NONINTERLEAVED)
 		return -EINVAL;
-	return snd_pcm_lib_read1(substream, (unsigned long)bufs, frames, nonblock, snd_pcm_lib_readv_transfer);
+	return snd_pcm_lib_read1(substream, (unsigned long)bufs, frames, nonblock, 1, snd_pcm_lib_readv_transfer);
 }
 
 EXPORT_SYMBOL(snd_pcm_lib_readv);
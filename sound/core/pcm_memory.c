@@ -24,6 +24,7 @@
 #include <linux/init.h>
 #include <linux/slab.h>
 #include <linux/moduleparam.h>
+#include <linux/mutex.h>
 #include <linux/vmalloc.h>
 #include <linux/export.h>
 #include <sound/core.h>
@@ -39,8 +40,207 @@ static int maximum_substreams = 4;
 module_param(maximum_substreams, int, 0444);
 MODULE_PARM_DESC(maximum_substreams, "Maximum substreams with preallocated DMA memory.");
 
+static int dma_pool_budget;
+module_param(dma_pool_budget, int, 0644);
+MODULE_PARM_DESC(dma_pool_budget, "Max. kB of released DMA buffers kept for reuse by other substreams (0 = disabled); while enabled, buffers are rounded up to a power of two pages.");
+
 static const size_t snd_minimum_buffer = 16384;
 
+/*
+ * DMA buffer pool
+ *
+ * Buffers allocated by snd_pcm_lib_malloc_pages() are rounded up to a
+ * power of two pages while the pool is enabled.  At hw_free they are
+ * kept in the list of their size class instead of being released, as
+ * long as the pool stays within dma_pool_budget, and the next substream
+ * asking for the same class on the same device picks them up again.
+ */
+#define SND_PCM_POOL_CLASSES	11	/* PAGE_SIZE up to 1024 pages */
+
+struct snd_pcm_pool_buf {
+	struct list_head list;
+	struct snd_dma_buffer dmab;
+};
+
+struct snd_pcm_pool_class {
+	struct list_head bufs;
+	unsigned int count;
+	unsigned long hits;
+	unsigned long misses;
+};
+
+static struct snd_pcm_pool_class pool_classes[SND_PCM_POOL_CLASSES];
+static size_t pool_bytes;
+static DEFINE_MUTEX(pool_mutex);
+
+/* release the pooled buffers of the given device, or all if NULL */
+static void snd_pcm_pool_shrink(struct snd_dma_device *dev)
+{
+	struct snd_pcm_pool_buf *buf, *next;
+	LIST_HEAD(dead);
+	int i;
+
+	mutex_lock(&pool_mutex);
+	for (i = 0; i < SND_PCM_POOL_CLASSES; i++) {
+		list_for_each_entry_safe(buf, next, &pool_classes[i].bufs,
+					 list) {
+			if (dev && (buf->dmab.dev.type != dev->type ||
+				    buf->dmab.dev.dev != dev->dev))
+				continue;
+			list_move(&buf->list, &dead);
+			pool_classes[i].count--;
+			pool_bytes -= buf->dmab.bytes;
+		}
+	}
+	mutex_unlock(&pool_mutex);
+
+	list_for_each_entry_safe(buf, next, &dead, list) {
+		snd_dma_free_pages(&buf->dmab);
+		kfree(buf);
+	}
+}
+
+/*
+ * allocate the DMA buffer, preferring a pooled one; dmab->dev must be
+ * set up by the caller
+ */
+static int snd_pcm_pool_alloc_pages(struct snd_dma_buffer *dmab, size_t size)
+{
+	struct snd_dma_device dev = dmab->dev;
+	struct snd_pcm_pool_class *cls;
+	struct snd_pcm_pool_buf *buf;
+	int order = get_order(size);
+
+	if (dma_pool_budget <= 0 || order >= SND_PCM_POOL_CLASSES)
+		return snd_dma_alloc_pages(dev.type, dev.dev, size, dmab);
+
+	cls = &pool_classes[order];
+	mutex_lock(&pool_mutex);
+	list_for_each_entry(buf, &cls->bufs, list) {
+		if (buf->dmab.dev.type == dev.type &&
+		    buf->dmab.dev.dev == dev.dev) {
+			list_del(&buf->list);
+			cls->count--;
+			cls->hits++;
+			pool_bytes -= buf->dmab.bytes;
+			mutex_unlock(&pool_mutex);
+			*dmab = buf->dmab;
+			kfree(buf);
+			/* don't hand over what the previous stream left */
+			if (dmab->area)
+				memset(dmab->area, 0, dmab->bytes);
+			return 0;
+		}
+	}
+	cls->misses++;
+	mutex_unlock(&pool_mutex);
+
+	if (!snd_dma_alloc_pages(dev.type, dev.dev, PAGE_SIZE << order, dmab))
+		return 0;
+	/* give the pooled memory back and retry with the exact size */
+	snd_pcm_pool_shrink(NULL);
+	return snd_dma_alloc_pages(dev.type, dev.dev, size, dmab);
+}
+
+/* return the buffer to the pool if it fits, otherwise release it */
+static void snd_pcm_pool_free_pages(struct snd_dma_buffer *dmab)
+{
+	struct snd_pcm_pool_buf *buf;
+	int order = get_order(dmab->bytes);
+
+	if (dma_pool_budget <= 0 || order >= SND_PCM_POOL_CLASSES ||
+	    dmab->bytes != PAGE_SIZE << order)
+		goto release;
+	buf = kmalloc(sizeof(*buf), GFP_KERNEL);
+	if (!buf)
+		goto release;
+	buf->dmab = *dmab;
+	mutex_lock(&pool_mutex);
+	if (pool_bytes + dmab->bytes > (size_t)dma_pool_budget * 1024) {
+		mutex_unlock(&pool_mutex);
+		kfree(buf);
+		goto release;
+	}
+	list_add(&buf->list, &pool_classes[order].bufs);
+	pool_classes[order].count++;
+	pool_bytes += dmab->bytes;
+	mutex_unlock(&pool_mutex);
+	return;
+
+ release:
+	snd_dma_free_pages(dmab);
+}
+
+#ifdef CONFIG_PROC_FS
+static struct snd_info_entry *snd_pcm_pool_proc_entry;
+
+static void snd_pcm_pool_proc_read(struct snd_info_entry *entry,
+				   struct snd_info_buffer *buffer)
+{
+	struct snd_pcm_pool_class *cls;
+	int i;
+
+	mutex_lock(&pool_mutex);
+	snd_iprintf(buffer, "budget: %d kB, pooled: %lu kB\n",
+		    dma_pool_budget, (unsigned long)pool_bytes / 1024);
+	snd_iprintf(buffer, "%10s %8s %12s %12s\n",
+		    "size(kB)", "pooled", "hits", "misses");
+	for (i = 0; i < SND_PCM_POOL_CLASSES; i++) {
+		cls = &pool_classes[i];
+		snd_iprintf(buffer, "%10lu %8u %12lu %12lu\n",
+			    (PAGE_SIZE << i) / 1024, cls->count,
+			    cls->hits, cls->misses);
+	}
+	mutex_unlock(&pool_mutex);
+}
+
+/* any write releases all pooled buffers */
+static void snd_pcm_pool_proc_write(struct snd_info_entry *entry,
+				    struct snd_info_buffer *buffer)
+{
+	snd_pcm_pool_shrink(NULL);
+}
+
+static void snd_pcm_pool_proc_init(void)
+{
+	struct snd_info_entry *entry;
+
+	if ((entry = snd_info_create_module_entry(THIS_MODULE, "pcm_pool", NULL)) != NULL) {
+		snd_info_set_text_ops(entry, NULL, snd_pcm_pool_proc_read);
+		entry->c.text.write = snd_pcm_pool_proc_write;
+		entry->mode |= S_IWUSR;
+		if (snd_info_register(entry) < 0) {
+			snd_info_free_entry(entry);
+			entry = NULL;
+		}
+	}
+	snd_pcm_pool_proc_entry = entry;
+}
+
+static void snd_pcm_pool_proc_done(void)
+{
+	snd_info_free_entry(snd_pcm_pool_proc_entry);
+}
+#else /* !CONFIG_PROC_FS */
+#define snd_pcm_pool_proc_init()
+#define snd_pcm_pool_proc_done()
+#endif /* CONFIG_PROC_FS */
+
+void snd_pcm_dma_pool_init(void)
+{
+	int i;
+
+	for (i = 0; i < SND_PCM_POOL_CLASSES; i++)
+		INIT_LIST_HEAD(&pool_classes[i].bufs);
+	snd_pcm_pool_proc_init();
+}
+
+void snd_pcm_dma_pool_done(void)
+{
+	snd_pcm_pool_proc_done();
+	snd_pcm_pool_shrink(NULL);
+}
+
 
 /*
  * try to allocate as the large pages as possible.
@@ -100,6 +300,8 @@ static void snd_pcm_lib_preallocate_dma_free(struct snd_pcm_substream *substream
 int snd_pcm_lib_preallocate_free(struct snd_pcm_substream *substream)
 {
 	snd_pcm_lib_preallocate_dma_free(substream);
+	/* the device may go away together with the PCM */
+	snd_pcm_pool_shrink(&substream->dma_buffer.dev);
 #ifdef CONFIG_SND_VERBOSE_PROCFS
 	snd_info_free_entry(substream->proc_prealloc_max_entry);
 	substream->proc_prealloc_max_entry = NULL;
@@ -371,9 +573,7 @@ int snd_pcm_lib_malloc_pages(struct snd_pcm_substream *substream, size_t size)
 		if (! dmab)
 			return -ENOMEM;
 		dmab->dev = substream->dma_buffer.dev;
-		if (snd_dma_alloc_pages(substream->dma_buffer.dev.type,
-					substream->dma_buffer.dev.dev,
-					size, dmab) < 0) {
+		if (snd_pcm_pool_alloc_pages(dmab, size) < 0) {
 			kfree(dmab);
 			return -ENOMEM;
 		}
@@ -404,7 +604,7 @@ int snd_pcm_lib_free_pages(struct snd_pcm_substream *substream)
 		return 0;
 	if (runtime->dma_buffer_p != &substream->dma_buffer) {
 		/* it's a newly allocated buffer.  release it now. */
-		snd_dma_free_pages(runtime->dma_buffer_p);
+		snd_pcm_pool_free_pages(runtime->dma_buffer_p);
 		kfree(runtime->dma_buffer_p);
 	}
 	snd_pcm_set_runtime_buffer(substream, NULL);
@@ -169,10 +169,9 @@ int snd_pcm_hw_refine(struct snd_pcm_substream *substream,
 	struct snd_interval *i = NULL;
 	struct snd_mask *m = NULL;
 	struct snd_pcm_hw_constraints *constrs = &substream->runtime->hw_constraints;
-	unsigned int rstamps[constrs->rules_num];
-	unsigned int vstamps[SNDRV_PCM_HW_PARAM_LAST_INTERVAL + 1];
-	unsigned int stamp = 2;
-	int changed, again;
+	unsigned long pending[BITS_TO_LONGS(constrs->rules_all) ? : 1];
+	unsigned int rules_num = constrs->rules_num;
+	int changed;
 
 	params->info = 0;
 	params->fifo_size = 0;
@@ -234,72 +233,81 @@ int snd_pcm_hw_refine(struct snd_pcm_substream *substream,
 			return changed;
 	}
 
-	for (k = 0; k < constrs->rules_num; k++)
-		rstamps[k] = 0;
-	for (k = 0; k <= SNDRV_PCM_HW_PARAM_LAST_INTERVAL; k++) 
-		vstamps[k] = (params->rmask & (1 << k)) ? 1 : 0;
-	do {
-		again = 0;
-		for (k = 0; k < constrs->rules_num; k++) {
-			struct snd_pcm_hw_rule *r = &constrs->rules[k];
-			unsigned int d;
-			int doit = 0;
-			if (r->cond && !(r->cond & params->flags))
-				continue;
-			for (d = 0; r->deps[d] >= 0; d++) {
-				if (vstamps[r->deps[d]] > rstamps[k]) {
-					doit = 1;
-					break;
-				}
-			}
-			if (!doit)
-				continue;
+	/*
+	 * Queue the rules depending on a requested param.  Each run of a
+	 * rule that changes its var queues the other rules depending on
+	 * that var; the queue is scanned in rule order, wrapping around
+	 * as long as anything is pending, so rules are evaluated in the
+	 * same order as with repeated passes over all of them.
+	 */
+	bitmap_zero(pending, rules_num);
+	for (k = 0; k <= SNDRV_PCM_HW_PARAM_LAST_INTERVAL; k++)
+		if (params->rmask & (1 << k))
+			bitmap_or(pending, pending,
+				  constrs_dependents(constrs, k), rules_num);
+	k = 0;
+	for (;;) {
+		struct snd_pcm_hw_rule *r;
+
+		k = find_next_bit(pending, rules_num, k);
+		if (k >= rules_num) {
+			k = find_first_bit(pending, rules_num);
+			if (k >= rules_num)
+				break;
+		}
+		__clear_bit(k, pending);
+		r = &constrs->rules[k];
+		if (r->cond && !(r->cond & params->flags)) {
+			k++;
+			continue;
+		}
 #ifdef RULES_DEBUG
-			printk(KERN_DEBUG "Rule %d [%p]: ", k, r->func);
-			if (r->var >= 0) {
-				printk("%s = ", snd_pcm_hw_param_names[r->var]);
-				if (hw_is_mask(r->var)) {
-					m = hw_param_mask(params, r->var);
-					printk("%x", *m->bits);
-				} else {
-					i = hw_param_interval(params, r->var);
-					if (i->empty)
-						printk("empty");
-					else
-						printk("%c%u %u%c", 
-						       i->openmin ? '(' : '[', i->min,
-						       i->max, i->openmax ? ')' : ']');
-				}
+		printk(KERN_DEBUG "Rule %d [%p]: ", k, r->func);
+		if (r->var >= 0) {
+			printk("%s = ", snd_pcm_hw_param_names[r->var]);
+			if (hw_is_mask(r->var)) {
+				m = hw_param_mask(params, r->var);
+				printk("%x", *m->bits);
+			} else {
+				i = hw_param_interval(params, r->var);
+				if (i->empty)
+					printk("empty");
+				else
+					printk("%c%u %u%c", 
+					       i->openmin ? '(' : '[', i->min,
+					       i->max, i->openmax ? ')' : ']');
 			}
+		}
 #endif
-			changed = r->func(params, r);
+		changed = r->func(params, r);
 #ifdef RULES_DEBUG
-			if (r->var >= 0) {
-				printk(" -> ");
-				if (hw_is_mask(r->var))
-					printk("%x", *m->bits);
-				else {
-					if (i->empty)
-						printk("empty");
-					else
-						printk("%c%u %u%c", 
-						       i->openmin ? '(' : '[', i->min,
-						       i->max, i->openmax ? ')' : ']');
-				}
+		if (r->var >= 0) {
+			printk(" -> ");
+			if (hw_is_mask(r->var))
+				printk("%x", *m->bits);
+			else {
+				if (i->empty)
+					printk("empty");
+				else
+					printk("%c%u %u%c", 
+					       i->openmin ? '(' : '[', i->min,
+					       i->max, i->openmax ? ')' : ']');
 			}
-			printk("\n");
+		}
+		printk("\n");
 #endif
-			rstamps[k] = stamp;
-			if (changed && r->var >= 0) {
-				params->cmask |= (1 << r->var);
-				vstamps[r->var] = stamp;
-				again = 1;
-			}
-			if (changed < 0)
-				return changed;
-			stamp++;
+		if (changed && r->var >= 0) {
+			params->cmask |= (1 << r->var);
+			bitmap_or(pending, pending,
+				  constrs_dependents(constrs, r->var),
+				  rules_num);
+			/* a rule doesn't retrigger itself */
+			__clear_bit(k, pending);
 		}
-	} while (again);
+		if (changed < 0)
+			return changed;
+		k++;
+	}
 	if (!params->msbits) {
 		i = hw_param_interval(params, SNDRV_PCM_HW_PARAM_SAMPLE_BITS);
 		if (snd_interval_single(i))
@@ -434,6 +442,16 @@ static int snd_pcm_hw_params(struct snd_pcm_substream *substream,
 	runtime->no_period_wakeup =
 			(params->info & SNDRV_PCM_INFO_NO_PERIOD_WAKEUP) &&
 			(params->flags & SNDRV_PCM_HW_PARAMS_NO_PERIOD_WAKEUP);
+	/* BATCH pointers only move per period, nothing to extrapolate */
+	runtime->timer_wakeup =
+			!(params->info & SNDRV_PCM_INFO_BATCH) &&
+			(params->flags & SNDRV_PCM_HW_PARAMS_TIMER_WAKEUP);
+	runtime->hw_ptr_ns = 0;
+	/* rounded up, so that the products never fall below the exact value */
+	runtime->frame_ns_mult = div_u64(((u64)NSEC_PER_SEC << 32) +
+					 runtime->rate - 1, runtime->rate);
+	runtime->frame_jiffies_mult = div_u64(((u64)HZ << 32) +
+					      runtime->rate - 1, runtime->rate);
 
 	bits = snd_pcm_format_physical_width(runtime->format);
 	runtime->sample_bits = bits;
@@ -445,7 +463,7 @@ static int snd_pcm_hw_params(struct snd_pcm_substream *substream,
 		frames *= 2;
 	}
 	runtime->byte_align = bits / 8;
-	runtime->min_align = frames;
+	runtime->min_align = frames;	/* always a power of two */
 
 	/* Default sw params */
 	runtime->tstamp_mode = SNDRV_PCM_TSTAMP_NONE;
@@ -863,13 +881,13 @@ static int snd_pcm_do_start(struct snd_pcm_substream *substream, int state)
 {
 	if (substream->runtime->trigger_master != substream)
 		return 0;
-	return substream->ops->trigger(substream, SNDRV_PCM_TRIGGER_START);
+	return snd_pcm_ops_trigger(substream, SNDRV_PCM_TRIGGER_START);
 }
 
 static void snd_pcm_undo_start(struct snd_pcm_substream *substream, int state)
 {
 	if (substream->runtime->trigger_master == substream)
-		substream->ops->trigger(substream, SNDRV_PCM_TRIGGER_STOP);
+		snd_pcm_ops_trigger(substream, SNDRV_PCM_TRIGGER_STOP);
 }
 
 static void snd_pcm_post_start(struct snd_pcm_substream *substream, int state)
@@ -883,9 +901,8 @@ static void snd_pcm_post_start(struct snd_pcm_substream *substream, int state)
 	if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK &&
 	    runtime->silence_size > 0)
 		snd_pcm_playback_silence(substream, ULONG_MAX);
-	if (substream->timer)
-		snd_timer_notify(substream->timer, SNDRV_TIMER_EVENT_MSTART,
-				 &runtime->trigger_tstamp);
+	snd_pcm_timer_notify(substream, SNDRV_TIMER_EVENT_MSTART);
+	snd_pcm_timer_resync(substream);
 }
 
 static struct action_ops snd_pcm_action_start = {
@@ -923,7 +940,7 @@ static int snd_pcm_do_stop(struct snd_pcm_substream *substream, int state)
 {
 	if (substream->runtime->trigger_master == substream &&
 	    snd_pcm_running(substream))
-		substream->ops->trigger(substream, SNDRV_PCM_TRIGGER_STOP);
+		snd_pcm_ops_trigger(substream, SNDRV_PCM_TRIGGER_STOP);
 	return 0; /* unconditonally stop all substreams */
 }
 
@@ -932,11 +949,10 @@ static void snd_pcm_post_stop(struct snd_pcm_substream *substream, int state)
 	struct snd_pcm_runtime *runtime = substream->runtime;
 	if (runtime->status->state != state) {
 		snd_pcm_trigger_tstamp(substream);
-		if (substream->timer)
-			snd_timer_notify(substream->timer, SNDRV_TIMER_EVENT_MSTOP,
-					 &runtime->trigger_tstamp);
+		snd_pcm_timer_notify(substream, SNDRV_TIMER_EVENT_MSTOP);
 		runtime->status->state = state;
 	}
+	hrtimer_try_to_cancel(&substream->wakeup_timer);
 	wake_up(&runtime->sleep);
 	wake_up(&runtime->tsleep);
 }
@@ -1008,17 +1024,17 @@ static int snd_pcm_do_pause(struct snd_pcm_substream *substream, int push)
 	 * delta, effectively to skip the check once.
 	 */
 	substream->runtime->hw_ptr_jiffies = jiffies - HZ * 1000;
-	return substream->ops->trigger(substream,
-				       push ? SNDRV_PCM_TRIGGER_PAUSE_PUSH :
-					      SNDRV_PCM_TRIGGER_PAUSE_RELEASE);
+	return snd_pcm_ops_trigger(substream,
+				   push ? SNDRV_PCM_TRIGGER_PAUSE_PUSH :
+				   SNDRV_PCM_TRIGGER_PAUSE_RELEASE);
 }
 
 static void snd_pcm_undo_pause(struct snd_pcm_substream *substream, int push)
 {
 	if (substream->runtime->trigger_master == substream)
-		substream->ops->trigger(substream,
-					push ? SNDRV_PCM_TRIGGER_PAUSE_RELEASE :
-					SNDRV_PCM_TRIGGER_PAUSE_PUSH);
+		snd_pcm_ops_trigger(substream,
+				    push ? SNDRV_PCM_TRIGGER_PAUSE_RELEASE :
+				    SNDRV_PCM_TRIGGER_PAUSE_PUSH);
 }
 
 static void snd_pcm_post_pause(struct snd_pcm_substream *substream, int push)
@@ -1027,18 +1043,13 @@ static void snd_pcm_post_pause(struct snd_pcm_substream *substream, int push)
 	snd_pcm_trigger_tstamp(substream);
 	if (push) {
 		runtime->status->state = SNDRV_PCM_STATE_PAUSED;
-		if (substream->timer)
-			snd_timer_notify(substream->timer,
-					 SNDRV_TIMER_EVENT_MPAUSE,
-					 &runtime->trigger_tstamp);
+		snd_pcm_timer_notify(substream, SNDRV_TIMER_EVENT_MPAUSE);
 		wake_up(&runtime->sleep);
 		wake_up(&runtime->tsleep);
 	} else {
 		runtime->status->state = SNDRV_PCM_STATE_RUNNING;
-		if (substream->timer)
-			snd_timer_notify(substream->timer,
-					 SNDRV_TIMER_EVENT_MCONTINUE,
-					 &runtime->trigger_tstamp);
+		snd_pcm_timer_notify(substream, SNDRV_TIMER_EVENT_MCONTINUE);
+		snd_pcm_timer_resync(substream);
 	}
 }
 
@@ -1076,7 +1087,7 @@ static int snd_pcm_do_suspend(struct snd_pcm_substream *substream, int state)
 		return 0;
 	if (! snd_pcm_running(substream))
 		return 0;
-	substream->ops->trigger(substream, SNDRV_PCM_TRIGGER_SUSPEND);
+	snd_pcm_ops_trigger(substream, SNDRV_PCM_TRIGGER_SUSPEND);
 	return 0; /* suspend unconditionally */
 }
 
@@ -1084,9 +1095,7 @@ static void snd_pcm_post_suspend(struct snd_pcm_substream *substream, int state)
 {
 	struct snd_pcm_runtime *runtime = substream->runtime;
 	snd_pcm_trigger_tstamp(substream);
-	if (substream->timer)
-		snd_timer_notify(substream->timer, SNDRV_TIMER_EVENT_MSUSPEND,
-				 &runtime->trigger_tstamp);
+	snd_pcm_timer_notify(substream, SNDRV_TIMER_EVENT_MSUSPEND);
 	runtime->status->suspended_state = runtime->status->state;
 	runtime->status->state = SNDRV_PCM_STATE_SUSPENDED;
 	wake_up(&runtime->sleep);
@@ -1177,24 +1186,23 @@ static int snd_pcm_do_resume(struct snd_pcm_substream *substream, int state)
 	    (runtime->status->suspended_state != SNDRV_PCM_STATE_DRAINING ||
 	     substream->stream != SNDRV_PCM_STREAM_PLAYBACK))
 		return 0;
-	return substream->ops->trigger(substream, SNDRV_PCM_TRIGGER_RESUME);
+	return snd_pcm_ops_trigger(substream, SNDRV_PCM_TRIGGER_RESUME);
 }
 
 static void snd_pcm_undo_resume(struct snd_pcm_substream *substream, int state)
 {
 	if (substream->runtime->trigger_master == substream &&
 	    snd_pcm_running(substream))
-		substream->ops->trigger(substream, SNDRV_PCM_TRIGGER_SUSPEND);
+		snd_pcm_ops_trigger(substream, SNDRV_PCM_TRIGGER_SUSPEND);
 }
 
 static void snd_pcm_post_resume(struct snd_pcm_substream *substream, int state)
 {
 	struct snd_pcm_runtime *runtime = substream->runtime;
 	snd_pcm_trigger_tstamp(substream);
-	if (substream->timer)
-		snd_timer_notify(substream->timer, SNDRV_TIMER_EVENT_MRESUME,
-				 &runtime->trigger_tstamp);
+	snd_pcm_timer_notify(substream, SNDRV_TIMER_EVENT_MRESUME);
 	runtime->status->state = runtime->status->suspended_state;
+	snd_pcm_timer_resync(substream);
 }
 
 static struct action_ops snd_pcm_action_resume = {
@@ -1331,7 +1339,7 @@ static int snd_pcm_pre_prepare(struct snd_pcm_substream *substream,
 static int snd_pcm_do_prepare(struct snd_pcm_substream *substream, int state)
 {
 	int err;
-	err = substream->ops->prepare(substream);
+	err = snd_pcm_ops_prepare(substream);
 	if (err < 0)
 		return err;
 	return snd_pcm_do_reset(substream, 0);
@@ -2495,6 +2503,7 @@ static int snd_pcm_sync_ptr(struct snd_pcm_substream *substream,
 	struct snd_pcm_sync_ptr sync_ptr;
 	volatile struct snd_pcm_mmap_status *status;
 	volatile struct snd_pcm_mmap_control *control;
+	unsigned int seq;
 	int err;
 
 	memset(&sync_ptr, 0, sizeof(sync_ptr));
@@ -2509,6 +2518,7 @@ static int snd_pcm_sync_ptr(struct snd_pcm_substream *substream,
 		if (err < 0)
 			return err;
 	}
+	/* the kernel updates appl_ptr under the stream lock, too */
 	snd_pcm_stream_lock_irq(substream);
 	if (!(sync_ptr.flags & SNDRV_PCM_SYNC_PTR_APPL))
 		control->appl_ptr = sync_ptr.c.control.appl_ptr;
@@ -2518,11 +2528,15 @@ static int snd_pcm_sync_ptr(struct snd_pcm_substream *substream,
 		control->avail_min = sync_ptr.c.control.avail_min;
 	else
 		sync_ptr.c.control.avail_min = control->avail_min;
-	sync_ptr.s.status.state = status->state;
-	sync_ptr.s.status.hw_ptr = status->hw_ptr;
-	sync_ptr.s.status.tstamp = status->tstamp;
-	sync_ptr.s.status.suspended_state = status->suspended_state;
 	snd_pcm_stream_unlock_irq(substream);
+	/* the status half is consistent under the sequence count alone */
+	do {
+		seq = snd_pcm_status_read_begin(runtime);
+		sync_ptr.s.status.state = status->state;
+		sync_ptr.s.status.hw_ptr = status->hw_ptr;
+		sync_ptr.s.status.tstamp = status->tstamp;
+		sync_ptr.s.status.suspended_state = status->suspended_state;
+	} while (snd_pcm_status_read_retry(runtime, seq));
 	if (copy_to_user(_sync_ptr, &sync_ptr, sizeof(sync_ptr)))
 		return -EFAULT;
 	return 0;
@@ -2611,6 +2625,141 @@ static int snd_pcm_common_ioctl1(struct file *file,
 	return -ENOTTY;
 }
 
+/*
+ * vectored transfer over several substreams of one link group
+ */
+#define SNDRV_PCM_XFER_MULTI_MAX	64
+
+/* refresh hw_ptr of all entries in a single pass under the group lock */
+static int snd_pcm_xferi_multi_sync(struct snd_pcm_substream *substream,
+				    struct snd_pcm_substream **subs,
+				    unsigned int count)
+{
+	struct snd_pcm_substream *s;
+	unsigned int i;
+	int res = 0;
+
+	read_lock_irq(&snd_pcm_link_rwlock);
+	if (snd_pcm_stream_linked(substream))
+		spin_lock(&substream->group->lock);
+	spin_lock(&substream->self_group.lock);
+	for (i = 0; i < count; i++) {
+		s = subs[i];
+		if (s->group != substream->group) {
+			res = -EBADFD;
+			break;
+		}
+		if (s != substream)
+			spin_lock_nested(&s->self_group.lock,
+					 SINGLE_DEPTH_NESTING);
+		if (s->runtime->status->state == SNDRV_PCM_STATE_RUNNING)
+			snd_pcm_update_hw_ptr(s);
+		if (s != substream)
+			spin_unlock(&s->self_group.lock);
+	}
+	spin_unlock(&substream->self_group.lock);
+	if (snd_pcm_stream_linked(substream))
+		spin_unlock(&substream->group->lock);
+	read_unlock_irq(&snd_pcm_link_rwlock);
+	return res;
+}
+
+/*
+ * do the transfers of a WRITEI_MULTI/READI_MULTI request; vec is the
+ * kernel copy of the request, the results are stored in vec[].result
+ */
+static int snd_pcm_xferi_multi_vec(struct snd_pcm_substream *substream,
+				   struct snd_xferi_vec *vec,
+				   unsigned int count)
+{
+	struct snd_pcm_substream **subs;
+	struct file **files;
+	struct snd_pcm_file *pcm_file;
+	unsigned int i, nfiles = 0;
+	int res = 0;
+
+	for (i = 0; i < count; i++)
+		vec[i].result = 0;
+	subs = kcalloc(count, sizeof(*subs), GFP_KERNEL);
+	files = kcalloc(count, sizeof(*files), GFP_KERNEL);
+	if (!subs || !files) {
+		res = -ENOMEM;
+		goto _free;
+	}
+
+	/* hold the file references until all transfers are done */
+	for (i = 0; i < count; i++) {
+		files[i] = fget(vec[i].fd);
+		if (!files[i]) {
+			res = -EBADFD;
+			goto _put;
+		}
+		nfiles++;
+		if (!is_pcm_file(files[i])) {
+			res = -EBADFD;
+			goto _put;
+		}
+		pcm_file = files[i]->private_data;
+		subs[i] = pcm_file->substream;
+		snd_card_unref(subs[i]->pcm->card);
+		if (subs[i]->stream != substream->stream ||
+		    !subs[i]->runtime ||
+		    subs[i]->runtime->status->state == SNDRV_PCM_STATE_OPEN) {
+			res = -EBADFD;
+			goto _put;
+		}
+	}
+
+	res = snd_pcm_xferi_multi_sync(substream, subs, count);
+	if (res < 0)
+		goto _put;
+
+	for (i = 0; i < count; i++) {
+		if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK)
+			vec[i].result = __snd_pcm_lib_write(subs[i], vec[i].buf,
+							    vec[i].frames, 0);
+		else
+			vec[i].result = __snd_pcm_lib_read(subs[i], vec[i].buf,
+							   vec[i].frames, 0);
+		if (vec[i].result < 0 && !res)
+			res = vec[i].result;
+	}
+
+ _put:
+	for (i = 0; i < nfiles; i++)
+		fput(files[i]);
+ _free:
+	kfree(files);
+	kfree(subs);
+	return res;
+}
+
+static int snd_pcm_xferi_multi(struct snd_pcm_substream *substream,
+			       struct snd_xferi_multi __user *_multi)
+{
+	struct snd_xferi_multi multi;
+	struct snd_xferi_vec *vec;
+	unsigned int i;
+	int res;
+
+	if (copy_from_user(&multi, _multi, sizeof(multi)))
+		return -EFAULT;
+	if (!multi.count || multi.count > SNDRV_PCM_XFER_MULTI_MAX)
+		return -EINVAL;
+	vec = memdup_user(multi.vec, sizeof(*vec) * multi.count);
+	if (IS_ERR(vec))
+		return PTR_ERR(vec);
+	res = snd_pcm_xferi_multi_vec(substream, vec, multi.count);
+	for (i = 0; i < multi.count; i++) {
+		if (put_user(vec[i].result, &multi.vec[i].result)) {
+			res = -EFAULT;
+			break;
+		}
+	}
+	kfree(vec);
+	return res;
+}
+
 static int snd_pcm_playback_ioctl1(struct file *file,
 				   struct snd_pcm_substream *substream,
 				   unsigned int cmd, void __user *arg)
@@ -2636,6 +2785,8 @@ static int snd_pcm_playback_ioctl1(struct file *file,
 		__put_user(result, &_xferi->result);
 		return result < 0 ? result : 0;
 	}
+	case SNDRV_PCM_IOCTL_WRITEI_MULTI:
+		return snd_pcm_xferi_multi(substream, arg);
 	case SNDRV_PCM_IOCTL_WRITEN_FRAMES:
 	{
 		struct snd_xfern xfern;
@@ -2716,6 +2867,8 @@ static int snd_pcm_capture_ioctl1(struct file *file,
 		__put_user(result, &_xferi->result);
 		return result < 0 ? result : 0;
 	}
+	case SNDRV_PCM_IOCTL_READI_MULTI:
+		return snd_pcm_xferi_multi(substream, arg);
 	case SNDRV_PCM_IOCTL_READN_FRAMES:
 	{
 		struct snd_xfern xfern;
@@ -2978,6 +3131,8 @@ static unsigned int snd_pcm_playback_poll(struct file *file, poll_table * wait)
 		mask = POLLOUT | POLLWRNORM | POLLERR;
 		break;
 	}
+	if (!mask)
+		snd_pcm_wakeup_timer_arm(substream);
 	snd_pcm_stream_unlock_irq(substream);
 	return mask;
 }
@@ -3021,6 +3176,8 @@ static unsigned int snd_pcm_capture_poll(struct file *file, poll_table * wait)
 		mask = POLLIN | POLLRDNORM | POLLERR;
 		break;
 	}
+	if (!mask)
+		snd_pcm_wakeup_timer_arm(substream);
 	snd_pcm_stream_unlock_irq(substream);
 	return mask;
 }
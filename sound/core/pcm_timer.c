@@ -21,29 +21,39 @@
 
 #include <linux/time.h>
 #include <linux/gcd.h>
+#include <linux/moduleparam.h>
+#include <linux/hrtimer.h>
 #include <sound/core.h>
 #include <sound/pcm.h>
 #include <sound/timer.h>
 
+static int timer_subticks = 8;
+module_param(timer_subticks, int, 0644);
+MODULE_PARM_DESC(timer_subticks, "Number of ticks per period of the interpolated PCM timers.");
+
+#define PCM_TIMER_MAX_SUBTICKS	64
+/* don't arm the interpolation timer closer than this */
+#define PCM_TIMER_MIN_NS	20000
+
 /*
  *  Timer functions
  */
 
-void snd_pcm_timer_resolution_change(struct snd_pcm_substream *substream)
+static unsigned int snd_pcm_timer_calc_resolution(struct snd_pcm_runtime *runtime,
+						  unsigned int subticks)
 {
 	unsigned long rate, mult, fsize, l, post;
-	struct snd_pcm_runtime *runtime = substream->runtime;
-	
+
         mult = 1000000000;
-	rate = runtime->rate;
+	rate = runtime->rate * subticks;
 	if (snd_BUG_ON(!rate))
-		return;
+		return -1;
 	l = gcd(mult, rate);
 	mult /= l;
 	rate /= l;
 	fsize = runtime->period_size;
 	if (snd_BUG_ON(!fsize))
-		return;
+		return -1;
 	l = gcd(rate, fsize);
 	rate /= l;
 	fsize /= l;
@@ -54,10 +64,25 @@ void snd_pcm_timer_resolution_change(struct snd_pcm_substream *substream)
 	}
 	if (rate == 0) {
 		snd_printk(KERN_ERR "pcm timer resolution out of range (rate = %u, period_size = %lu)\n", runtime->rate, runtime->period_size);
-		runtime->timer_resolution = -1;
-		return;
+		return -1;
 	}
-	runtime->timer_resolution = (mult * fsize / rate) * post;
+	return (mult * fsize / rate) * post;
+}
+
+void snd_pcm_timer_resolution_change(struct snd_pcm_substream *substream)
+{
+	struct snd_pcm_runtime *runtime = substream->runtime;
+	unsigned int subticks;
+	
+	subticks = clamp(timer_subticks, 1, PCM_TIMER_MAX_SUBTICKS);
+	if (subticks > runtime->period_size)
+		subticks = runtime->period_size ? runtime->period_size : 1;
+	runtime->timer_subticks = subticks;
+	runtime->timer_subtick = 0;
+	runtime->timer_resolution =
+		snd_pcm_timer_calc_resolution(runtime, 1);
+	runtime->timer_sub_resolution =
+		snd_pcm_timer_calc_resolution(runtime, subticks);
 }
 
 static unsigned long snd_pcm_timer_resolution(struct snd_timer * timer)
@@ -68,6 +93,148 @@ static unsigned long snd_pcm_timer_resolution(struct snd_timer * timer)
 	return substream->runtime ? substream->runtime->timer_resolution : 0;
 }
 
+static unsigned long snd_pcm_timer_sub_resolution(struct snd_timer *timer)
+{
+	struct snd_pcm_substream *substream;
+	
+	substream = timer->private_data;
+	return substream->runtime ? substream->runtime->timer_sub_resolution : 0;
+}
+
+/*
+ * the sub-period tick the stream is in, from the hw_ptr and the time
+ * passed since it moved last (for drivers with coarse pointers);
+ * the last tick of a period is left to the period interrupt.
+ * call with the stream lock held
+ */
+static unsigned int snd_pcm_timer_subtick(struct snd_pcm_runtime *runtime,
+					  snd_pcm_uframes_t *framesp)
+{
+	snd_pcm_sframes_t frames;
+	u64 extra = 0;
+	s64 elapsed;
+	unsigned int tick;
+
+	frames = runtime->status->hw_ptr - runtime->hw_ptr_interrupt;
+	if (frames < 0)
+		frames += runtime->boundary;
+	elapsed = ktime_to_ns(ktime_get()) - runtime->hw_ptr_ns;
+	if (runtime->hw_ptr_ns && elapsed > 0)
+		extra = div_u64((u64)elapsed * runtime->rate, NSEC_PER_SEC);
+	/* a stamp older than a period is from before a restart */
+	if (extra < runtime->period_size)
+		frames += extra;
+	if ((snd_pcm_uframes_t)frames > runtime->period_size)
+		frames = runtime->period_size;
+	*framesp = frames;
+	tick = div_u64((u64)frames * runtime->timer_subticks,
+		       runtime->period_size);
+	if (tick >= runtime->timer_subticks)
+		tick = runtime->timer_subticks - 1;
+	return tick;
+}
+
+/*
+ * arm the interpolation timer for the next sub-period tick;
+ * call with the stream lock held
+ */
+static void snd_pcm_timer_arm(struct snd_pcm_substream *substream)
+{
+	struct snd_pcm_runtime *runtime = substream->runtime;
+	snd_pcm_uframes_t frames, target;
+	unsigned int next;
+	u64 delay = 0;
+
+	if (runtime->timer_subticks <= 1 || !substream->timer_sub_running ||
+	    !snd_pcm_running(substream))
+		return;
+	next = runtime->timer_subtick + 1;
+	if (next >= runtime->timer_subticks)
+		return;	/* resynchronized by the period interrupt */
+	target = DIV_ROUND_UP((u64)next * runtime->period_size,
+			      runtime->timer_subticks);
+	snd_pcm_timer_subtick(runtime, &frames);
+	if (target > frames)
+		delay = div_u64((u64)(target - frames) * NSEC_PER_SEC,
+				runtime->rate);
+	if (delay < PCM_TIMER_MIN_NS)
+		delay = PCM_TIMER_MIN_NS;
+	hrtimer_start(&substream->timer_interp, ns_to_ktime(delay),
+		      HRTIMER_MODE_REL);
+}
+
+/*
+ * tick the period timer, deliver the ticks left in the elapsed period
+ * to the interpolated timer and restart the interpolation from the new
+ * period boundary;
+ * called from snd_pcm_period_elapsed() with the stream lock held
+ */
+void snd_pcm_timer_period_elapsed(struct snd_pcm_substream *substream)
+{
+	struct snd_pcm_runtime *runtime = substream->runtime;
+	unsigned long ticks;
+
+	if (substream->timer_running)
+		snd_timer_interrupt(substream->timer, 1);
+	if (!substream->timer_sub_running)
+		return;
+	ticks = runtime->timer_subticks - runtime->timer_subtick;
+	runtime->timer_subtick = 0;
+	snd_timer_interrupt(substream->timer_sub, ticks);
+	snd_pcm_timer_arm(substream);
+}
+
+/*
+ * restart the interpolation when the stream is started, released from
+ * pause or resumed; a tick count left over from before a stop or an
+ * xrun is pulled back to the current position so that the whole
+ * period is delivered again.
+ * called with the stream lock held
+ */
+void snd_pcm_timer_resync(struct snd_pcm_substream *substream)
+{
+	struct snd_pcm_runtime *runtime = substream->runtime;
+	snd_pcm_uframes_t frames;
+	unsigned int tick;
+
+	if (runtime->timer_subticks <= 1 || !substream->timer_sub_running)
+		return;
+	/* the hw_ptr didn't move while the stream was stopped */
+	runtime->hw_ptr_ns = ktime_to_ns(ktime_get());
+	tick = snd_pcm_timer_subtick(runtime, &frames);
+	if (runtime->timer_subtick > tick)
+		runtime->timer_subtick = tick;
+	snd_pcm_timer_arm(substream);
+}
+
+enum hrtimer_restart snd_pcm_timer_interp_func(struct hrtimer *hrt)
+{
+	struct snd_pcm_substream *substream =
+		container_of(hrt, struct snd_pcm_substream, timer_interp);
+	struct snd_pcm_runtime *runtime;
+	snd_pcm_uframes_t frames;
+	unsigned int tick;
+	unsigned long flags;
+
+	snd_pcm_stream_lock_irqsave(substream, flags);
+	runtime = substream->runtime;
+	if (!runtime || !substream->timer_sub_running ||
+	    !snd_pcm_running(substream) ||
+	    snd_pcm_update_hw_ptr(substream) < 0)
+		goto unlock;
+	tick = snd_pcm_timer_subtick(runtime, &frames);
+	if (tick > runtime->timer_subtick) {
+		unsigned long ticks = tick - runtime->timer_subtick;
+
+		runtime->timer_subtick = tick;
+		snd_timer_interrupt(substream->timer_sub, ticks);
+	}
+	snd_pcm_timer_arm(substream);
+ unlock:
+	snd_pcm_stream_unlock_irqrestore(substream, flags);
+	return HRTIMER_NORESTART;
+}
+
 static int snd_pcm_timer_start(struct snd_timer * timer)
 {
 	struct snd_pcm_substream *substream;
@@ -86,6 +253,33 @@ static int snd_pcm_timer_stop(struct snd_timer * timer)
 	return 0;
 }
 
+static int snd_pcm_timer_sub_start(struct snd_timer *timer)
+{
+	struct snd_pcm_substream *substream;
+
+	substream = snd_timer_chip(timer);
+	substream->timer_sub_running = 1;
+	/*
+	 * the stream lock can't be taken under timer->lock; let the
+	 * interpolation timer pick up the position
+	 */
+	if (substream->runtime && substream->runtime->timer_subticks > 1)
+		hrtimer_start(&substream->timer_interp,
+			      ns_to_ktime(PCM_TIMER_MIN_NS), HRTIMER_MODE_REL);
+	return 0;
+}
+
+static int snd_pcm_timer_sub_stop(struct snd_timer *timer)
+{
+	struct snd_pcm_substream *substream;
+
+	substream = snd_timer_chip(timer);
+	substream->timer_sub_running = 0;
+	/* may be called from the interpolation timer itself */
+	hrtimer_try_to_cancel(&substream->timer_interp);
+	return 0;
+}
+
 static struct snd_timer_hardware snd_pcm_timer =
 {
 	.flags =	SNDRV_TIMER_HW_AUTO | SNDRV_TIMER_HW_SLAVE,
@@ -96,6 +290,31 @@ static struct snd_timer_hardware snd_pcm_timer =
 	.stop =		snd_pcm_timer_stop,
 };
 
+/*
+ * the same stream clock ticking timer_subticks times per period; a
+ * separate subdevice so that the period timer used by dmix & co.
+ * keeps its resolution
+ */
+static struct snd_timer_hardware snd_pcm_sub_timer =
+{
+	.flags =	SNDRV_TIMER_HW_AUTO | SNDRV_TIMER_HW_SLAVE,
+	.resolution =	0,
+	.ticks =	1,
+	.c_resolution =	snd_pcm_timer_sub_resolution,
+	.start =	snd_pcm_timer_sub_start,
+	.stop =		snd_pcm_timer_sub_stop,
+};
+
+void snd_pcm_timer_notify(struct snd_pcm_substream *substream, int event)
+{
+	struct timespec *tstamp = &substream->runtime->trigger_tstamp;
+
+	if (substream->timer)
+		snd_timer_notify(substream->timer, event, tstamp);
+	if (substream->timer_sub)
+		snd_timer_notify(substream->timer_sub, event, tstamp);
+}
+
 /*
  *  Init functions
  */
@@ -106,7 +325,14 @@ static void snd_pcm_timer_free(struct snd_timer *timer)
 	substream->timer = NULL;
 }
 
-void snd_pcm_timer_init(struct snd_pcm_substream *substream)
+static void snd_pcm_timer_sub_free(struct snd_timer *timer)
+{
+	struct snd_pcm_substream *substream = timer->private_data;
+	substream->timer_sub = NULL;
+}
+
+static struct snd_timer *snd_pcm_timer_create(struct snd_pcm_substream *substream,
+					      int interp)
 {
 	struct snd_timer_id tid;
 	struct snd_timer *timer;
@@ -116,24 +342,40 @@ void snd_pcm_timer_init(struct snd_pcm_substream *substream)
 	tid.card = substream->pcm->card->number;
 	tid.device = substream->pcm->device;
 	tid.subdevice = (substream->number << 1) | (substream->stream & 1);
+	if (interp)
+		tid.subdevice |= SNDRV_TIMER_PCM_INTERP;
 	if (snd_timer_new(substream->pcm->card, "PCM", &tid, &timer) < 0)
-		return;
-	sprintf(timer->name, "PCM %s %i-%i-%i",
+		return NULL;
+	sprintf(timer->name, "PCM %s %i-%i-%i%s",
 			substream->stream == SNDRV_PCM_STREAM_CAPTURE ?
 				"capture" : "playback",
-			tid.card, tid.device, tid.subdevice);
-	timer->hw = snd_pcm_timer;
+			tid.card, tid.device,
+			tid.subdevice & ~SNDRV_TIMER_PCM_INTERP,
+			interp ? " interpolated" : "");
+	timer->hw = interp ? snd_pcm_sub_timer : snd_pcm_timer;
 	if (snd_device_register(timer->card, timer) < 0) {
 		snd_device_free(timer->card, timer);
-		return;
+		return NULL;
 	}
 	timer->private_data = substream;
-	timer->private_free = snd_pcm_timer_free;
-	substream->timer = timer;
+	timer->private_free = interp ? snd_pcm_timer_sub_free :
+				       snd_pcm_timer_free;
+	return timer;
+}
+
+void snd_pcm_timer_init(struct snd_pcm_substream *substream)
+{
+	substream->timer = snd_pcm_timer_create(substream, 0);
+	if (substream->timer)
+		substream->timer_sub = snd_pcm_timer_create(substream, 1);
 }
 
 void snd_pcm_timer_done(struct snd_pcm_substream *substream)
 {
+	if (substream->timer_sub) {
+		snd_device_free(substream->pcm->card, substream->timer_sub);
+		substream->timer_sub = NULL;
+	}
 	if (substream->timer) {
 		snd_device_free(substream->pcm->card, substream->timer);
 		substream->timer = NULL;
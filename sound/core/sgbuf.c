@@ -23,8 +23,13 @@
 #include <linux/mm.h>
 #include <linux/vmalloc.h>
 #include <linux/export.h>
+#include <linux/moduleparam.h>
 #include <sound/memalloc.h>
 
+static bool sgbuf_large_chunks;
+module_param(sgbuf_large_chunks, bool, 0644);
+MODULE_PARM_DESC(sgbuf_large_chunks, "Try to allocate SG-buffers in chunks of up to 4MB instead of 128kB.");
+
 
 /* table entries are align to 32 */
 #define SGBUF_TBL_ALIGN		32
@@ -56,6 +61,7 @@ int snd_free_sgbuf_pages(struct snd_dma_buffer *dmab)
 
 	kfree(sgbuf->table);
 	kfree(sgbuf->page_table);
+	kfree(sgbuf->run_table);
 	kfree(sgbuf);
 	dmab->private_data = NULL;
 	
@@ -63,6 +69,37 @@ int snd_free_sgbuf_pages(struct snd_dma_buffer *dmab)
 }
 
 #define MAX_ALLOC_PAGES		32
+#define MAX_LARGE_ALLOC_PAGES	1024	/* fits in the head mark of addr */
+
+/*
+ * record the runs of physically continuous pages; adjacent chunks that
+ * happen to be continuous are merged.  Without the table (on allocation
+ * failure), snd_sgbuf_get_chunk_size() walks the page table instead.
+ */
+static void sgbuf_build_runs(struct snd_sg_buf *sgbuf)
+{
+	struct snd_sg_run *run;
+	unsigned int i, runs = 1;
+
+	for (i = 1; i < sgbuf->pages; i++)
+		if ((sgbuf->table[i].addr >> PAGE_SHIFT) !=
+		    (sgbuf->table[i - 1].addr >> PAGE_SHIFT) + 1)
+			runs++;
+	run = kcalloc(runs, sizeof(*run), GFP_KERNEL);
+	if (!run)
+		return;
+	sgbuf->run_table = run;
+	sgbuf->runs = runs;
+	run->pages = 1;
+	for (i = 1; i < sgbuf->pages; i++) {
+		if ((sgbuf->table[i].addr >> PAGE_SHIFT) !=
+		    (sgbuf->table[i - 1].addr >> PAGE_SHIFT) + 1) {
+			run++;
+			run->page = i;
+		}
+		run->pages++;
+	}
+}
 
 void *snd_malloc_sgbuf_pages(struct device *device,
 			     size_t size, struct snd_dma_buffer *dmab,
@@ -92,7 +129,7 @@ void *snd_malloc_sgbuf_pages(struct device *device,
 	sgbuf->page_table = pgtable;
 
 	/* allocate pages */
-	maxpages = MAX_ALLOC_PAGES;
+	maxpages = sgbuf_large_chunks ? MAX_LARGE_ALLOC_PAGES : MAX_ALLOC_PAGES;
 	while (pages > 0) {
 		chunk = pages;
 		/* don't be too eager to take a huge chunk */
@@ -126,6 +163,7 @@ void *snd_malloc_sgbuf_pages(struct device *device,
 	}
 
 	sgbuf->size = size;
+	sgbuf_build_runs(sgbuf);
 	dmab->area = vmap(sgbuf->page_table, sgbuf->pages, VM_MAP, PAGE_KERNEL);
 	if (! dmab->area)
 		goto _failed;
@@ -148,6 +186,22 @@ unsigned int snd_sgbuf_get_chunk_size(struct snd_dma_buffer *dmab,
 	unsigned int start, end, pg;
 
 	start = ofs >> PAGE_SHIFT;
+	if (sg->run_table) {
+		struct snd_sg_run *run;
+		unsigned int lo = 0, hi = sg->runs - 1, mid;
+
+		/* the last run starting at or before the page */
+		while (lo < hi) {
+			mid = (lo + hi + 1) / 2;
+			if (sg->run_table[mid].page <= start)
+				lo = mid;
+			else
+				hi = mid - 1;
+		}
+		run = &sg->run_table[lo];
+		end = (run->page + run->pages) << PAGE_SHIFT;
+		return min(size, end - ofs);
+	}
 	end = (ofs + size - 1) >> PAGE_SHIFT;
 	/* check page continuity */
 	pg = sg->table[start].addr >> PAGE_SHIFT;
@@ -487,6 +487,7 @@ static void __exit alsa_sound_exit(void)
 	snd_info_minor_unregister();
 	snd_info_done();
 	unregister_chrdev(major, "alsa");
+	rcu_barrier();	/* pending snd_ctl_free_one() callbacks */
 }
 
 subsys_initcall(alsa_sound_init);
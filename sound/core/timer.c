@@ -22,6 +22,9 @@
 #include <linux/delay.h>
 #include <linux/init.h>
 #include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/log2.h>
+#include <linux/mm.h>
 #include <linux/time.h>
 #include <linux/mutex.h>
 #include <linux/device.h>
@@ -61,13 +64,20 @@ struct snd_timer_user {
 	int tread;		/* enhanced read with timestamps and events */
 	unsigned long ticks;
 	unsigned long overrun;
-	int qhead;
-	int qtail;
-	int qused;
-	int queue_size;
+	struct snd_timer_mmap_queue *qhdr;	/* queue buffer, mmap-able */
+	size_t qbytes;			/* size of the queue buffer */
+	unsigned int qmask;		/* ring slots - 1 */
+	unsigned int qtail;		/* records produced */
+	int queue_size;			/* max queued records */
+	unsigned int qstaged: 1;	/* record at tail still coalescing */
+	unsigned int qmapped: 1;	/* queue buffer is mmapped */
+	unsigned int avail_min;		/* wakeup threshold in events */
+	unsigned int qevents;		/* events queued since the last wakeup */
+	u64 max_delay_ns;		/* wakeup deadline, 0 = none */
+	u64 qfirst_ns;			/* when the queue became non-empty */
 	struct snd_timer_read *queue;
 	struct snd_timer_tread *tqueue;
-	spinlock_t qlock;
+	spinlock_t qlock;		/* serializes the producers */
 	unsigned long last_resolution;
 	unsigned int filter;
 	struct timespec tstamp;		/* trigger tstamp */
@@ -611,6 +621,22 @@ static void snd_timer_reschedule(struct snd_timer * timer, unsigned long ticks_l
 	timer->sticks = ticks;
 }
 
+/*
+ * account the latency of a callback about to be made;
+ * called with timer->lock held
+ */
+static void snd_timer_account(struct snd_timer_instance *ti)
+{
+	s64 lat = ktime_to_ns(ktime_sub(ktime_get(), ti->tstamp));
+
+	if (lat < 0)
+		lat = 0;
+	ti->callbacks++;
+	ti->lat_total += lat;
+	if (lat > ti->lat_max)
+		ti->lat_max = lat;
+}
+
 /*
  * timer tasklet
  *
@@ -636,6 +662,7 @@ static void snd_timer_tasklet(unsigned long arg)
 		ti->pticks = 0;
 		resolution = ti->resolution;
 
+		snd_timer_account(ti);
 		ti->flags |= SNDRV_TIMER_IFLG_CALLBACK;
 		spin_unlock(&timer->lock);
 		if (ti->callback)
@@ -656,14 +683,16 @@ void snd_timer_interrupt(struct snd_timer * timer, unsigned long ticks_left)
 {
 	struct snd_timer_instance *ti, *ts, *tmp;
 	unsigned long resolution, ticks;
-	struct list_head *p, *ack_list_head;
-	unsigned long flags;
+	struct list_head *p, *ack_list_head, *slave_list_head;
+	unsigned long flags, missed;
 	int use_tasklet = 0;
+	ktime_t now;
 
 	if (timer == NULL)
 		return;
 
 	spin_lock_irqsave(&timer->lock, flags);
+	now = ktime_get();
 
 	/* remember the current resolution */
 	if (timer->hw.c_resolution)
@@ -682,9 +711,13 @@ void snd_timer_interrupt(struct snd_timer * timer, unsigned long ticks_left)
 			continue;
 		ti->pticks += ticks_left;
 		ti->resolution = resolution;
-		if (ti->cticks < ticks_left)
+		missed = 0;
+		if (ti->cticks < ticks_left) {
+			/* count the periods passed without an own callback */
+			if ((ti->flags & SNDRV_TIMER_IFLG_AUTO) && ti->ticks)
+				missed = (ticks_left - ti->cticks) / ti->ticks;
 			ti->cticks = 0;
-		else
+		} else
 			ti->cticks -= ticks_left;
 		if (ti->cticks) /* not expired */
 			continue;
@@ -700,13 +733,24 @@ void snd_timer_interrupt(struct snd_timer * timer, unsigned long ticks_left)
 			ack_list_head = &timer->ack_list_head;
 		else
 			ack_list_head = &timer->sack_list_head;
-		if (list_empty(&ti->ack_list))
+		if (list_empty(&ti->ack_list)) {
+			ti->tstamp = now;
 			list_add_tail(&ti->ack_list, ack_list_head);
+		}
+		ti->missed += missed;
 		list_for_each_entry(ts, &ti->slave_active_head, active_list) {
 			ts->pticks = ti->pticks;
 			ts->resolution = resolution;
-			if (list_empty(&ts->ack_list))
-				list_add_tail(&ts->ack_list, ack_list_head);
+			ts->missed += missed;
+			/* fast slaves don't wait for the tasklet of the master */
+			if (ts->flags & SNDRV_TIMER_IFLG_FAST)
+				slave_list_head = &timer->ack_list_head;
+			else
+				slave_list_head = ack_list_head;
+			if (list_empty(&ts->ack_list)) {
+				ts->tstamp = now;
+				list_add_tail(&ts->ack_list, slave_list_head);
+			}
 		}
 	}
 	if (timer->flags & SNDRV_TIMER_FLG_RESCHED)
@@ -737,6 +781,7 @@ void snd_timer_interrupt(struct snd_timer * timer, unsigned long ticks_left)
 		ticks = ti->pticks;
 		ti->pticks = 0;
 
+		snd_timer_account(ti);
 		ti->flags |= SNDRV_TIMER_IFLG_CALLBACK;
 		spin_unlock(&timer->lock);
 		if (ti->callback)
@@ -1042,11 +1087,40 @@ static int snd_timer_register_system(void)
  *  Info interface
  */
 
+static void snd_timer_proc_instance(struct snd_info_buffer *buffer,
+				    struct snd_timer *timer,
+				    struct snd_timer_instance *ti,
+				    const char *kind)
+{
+	unsigned long flags, callbacks, missed, lat_max;
+	u64 lat_avg;
+	int running;
+
+	spin_lock_irqsave(&timer->lock, flags);
+	running = ti->flags & (SNDRV_TIMER_IFLG_START |
+			       SNDRV_TIMER_IFLG_RUNNING);
+	callbacks = ti->callbacks;
+	missed = ti->missed;
+	lat_max = ti->lat_max;
+	lat_avg = ti->lat_total;
+	spin_unlock_irqrestore(&timer->lock, flags);
+
+	if (callbacks)
+		lat_avg = div_u64(lat_avg, callbacks);
+	snd_iprintf(buffer, "  %s %s : %s%s\n", kind,
+		    ti->owner ? ti->owner : "unknown",
+		    running ? "running" : "stopped",
+		    ti->flags & SNDRV_TIMER_IFLG_FAST ? " FAST" : "");
+	snd_iprintf(buffer, "    callbacks %lu, missed %lu, "
+		    "latency avg %lluns max %luns\n",
+		    callbacks, missed, (unsigned long long)lat_avg, lat_max);
+}
+
 static void snd_timer_proc_read(struct snd_info_entry *entry,
 				struct snd_info_buffer *buffer)
 {
 	struct snd_timer *timer;
-	struct snd_timer_instance *ti;
+	struct snd_timer_instance *ti, *ts;
 
 	mutex_lock(&register_mutex);
 	list_for_each_entry(timer, &snd_timer_list, device_list) {
@@ -1076,12 +1150,12 @@ static void snd_timer_proc_read(struct snd_info_entry *entry,
 		if (timer->hw.flags & SNDRV_TIMER_HW_SLAVE)
 			snd_iprintf(buffer, " SLAVE");
 		snd_iprintf(buffer, "\n");
-		list_for_each_entry(ti, &timer->open_list_head, open_list)
-			snd_iprintf(buffer, "  Client %s : %s\n",
-				    ti->owner ? ti->owner : "unknown",
-				    ti->flags & (SNDRV_TIMER_IFLG_START |
-						 SNDRV_TIMER_IFLG_RUNNING)
-				    ? "running" : "stopped");
+		list_for_each_entry(ti, &timer->open_list_head, open_list) {
+			snd_timer_proc_instance(buffer, timer, ti, "Client");
+			list_for_each_entry(ts, &ti->slave_list_head, open_list)
+				snd_timer_proc_instance(buffer, timer, ts,
+							"  Slave");
+		}
 	}
 	mutex_unlock(&register_mutex);
 }
@@ -1116,48 +1190,141 @@ static void __exit snd_timer_proc_done(void)
  *  USER SPACE interface
  */
 
+/*
+ * The read queue is a ring shared with the reader without a lock: the
+ * producers (timer callbacks, serialized by qlock) only move tail, the
+ * reader (read() or user space through mmap) only moves head.  The
+ * header is writable through the mapping, so the kernel keeps tail and
+ * overrun in struct snd_timer_user and only mirrors them there.  The
+ * record at tail may be "staged": it is not visible yet and further
+ * ticks are coalesced into it.  It gets published when a new record is
+ * started, when the reader is woken up while the ring is empty, or
+ * when the reader finds nothing else to read.
+ */
+static inline unsigned int snd_timer_user_published(struct snd_timer_user *tu)
+{
+	return ACCESS_ONCE(tu->qtail) - ACCESS_ONCE(tu->qhdr->head);
+}
+
+/* records available to the reader, the staged one included */
+static inline unsigned int snd_timer_user_queued(struct snd_timer_user *tu)
+{
+	return snd_timer_user_published(tu) + tu->qstaged;
+}
+
+static inline void *snd_timer_user_slot(struct snd_timer_user *tu,
+					unsigned int index)
+{
+	index &= tu->qmask;
+	if (tu->tread)
+		return &tu->tqueue[index];
+	return &tu->queue[index];
+}
+
+/* the caller must hold qlock */
+static void snd_timer_user_publish(struct snd_timer_user *tu)
+{
+	if (!tu->qstaged)
+		return;
+	smp_wmb();	/* record contents before tail */
+	tu->qtail++;
+	tu->qhdr->tail = tu->qtail;
+	tu->qstaged = 0;
+}
+
+/* the staged record to coalesce into, or NULL; the caller holds qlock */
+static void *snd_timer_user_staged(struct snd_timer_user *tu)
+{
+	if (!tu->qstaged)
+		return NULL;
+	return snd_timer_user_slot(tu, tu->qtail);
+}
+
+/*
+ * Start a new (staged) record, publishing the previous one.  Returns
+ * NULL and counts an overrun when the queue is full.  The caller must
+ * hold qlock.
+ */
+static void *snd_timer_user_new_record(struct snd_timer_user *tu)
+{
+	unsigned int queued = snd_timer_user_queued(tu);
+
+	if (queued >= tu->queue_size) {
+		tu->overrun++;
+		tu->qhdr->overrun = tu->overrun;
+		return NULL;
+	}
+	if (!queued && tu->max_delay_ns)
+		tu->qfirst_ns = ktime_to_ns(ktime_get());
+	snd_timer_user_publish(tu);
+	tu->qstaged = 1;
+	return snd_timer_user_slot(tu, tu->qtail);
+}
+
+/*
+ * Decide whether to wake up the reader after queueing an event; with
+ * force (control events) or default settings any queued record does.
+ * Ticks merged into the staged record count toward avail_min as well,
+ * otherwise a record that keeps coalescing would never reach it.  The
+ * staged record is published on wakeup if the reader has caught up,
+ * otherwise it keeps coalescing until the reader gets to it.  The
+ * caller must hold qlock.
+ */
+static bool snd_timer_user_wake_now(struct snd_timer_user *tu, bool force)
+{
+	unsigned int queued = snd_timer_user_queued(tu);
+
+	if (!queued)
+		return false;
+	tu->qevents++;
+	if (!force && queued < tu->avail_min && tu->qevents < tu->avail_min &&
+	    (!tu->max_delay_ns ||
+	     ktime_to_ns(ktime_get()) - tu->qfirst_ns < tu->max_delay_ns))
+		return false;
+	tu->qevents = 0;
+	if (!snd_timer_user_published(tu) || tu->qmapped)
+		snd_timer_user_publish(tu);
+	return true;
+}
+
+static void snd_timer_user_wakeup(struct snd_timer_user *tu)
+{
+	kill_fasync(&tu->fasync, SIGIO, POLL_IN);
+	wake_up(&tu->qchange_sleep);
+}
+
 static void snd_timer_user_interrupt(struct snd_timer_instance *timeri,
 				     unsigned long resolution,
 				     unsigned long ticks)
 {
 	struct snd_timer_user *tu = timeri->callback_data;
 	struct snd_timer_read *r;
-	int prev;
+	bool wake;
 
 	spin_lock(&tu->qlock);
-	if (tu->qused > 0) {
-		prev = tu->qtail == 0 ? tu->queue_size - 1 : tu->qtail - 1;
-		r = &tu->queue[prev];
-		if (r->resolution == resolution) {
-			r->ticks += ticks;
-			goto __wake;
-		}
-	}
-	if (tu->qused >= tu->queue_size) {
-		tu->overrun++;
+	r = snd_timer_user_staged(tu);
+	if (r && r->resolution == resolution) {
+		r->ticks += ticks;
 	} else {
-		r = &tu->queue[tu->qtail++];
-		tu->qtail %= tu->queue_size;
-		r->resolution = resolution;
-		r->ticks = ticks;
-		tu->qused++;
+		r = snd_timer_user_new_record(tu);
+		if (r) {
+			r->resolution = resolution;
+			r->ticks = ticks;
+		}
 	}
-      __wake:
+	wake = snd_timer_user_wake_now(tu, false);
 	spin_unlock(&tu->qlock);
-	kill_fasync(&tu->fasync, SIGIO, POLL_IN);
-	wake_up(&tu->qchange_sleep);
+	if (wake)
+		snd_timer_user_wakeup(tu);
 }
 
 static void snd_timer_user_append_to_tqueue(struct snd_timer_user *tu,
 					    struct snd_timer_tread *tread)
 {
-	if (tu->qused >= tu->queue_size) {
-		tu->overrun++;
-	} else {
-		memcpy(&tu->tqueue[tu->qtail++], tread, sizeof(*tread));
-		tu->qtail %= tu->queue_size;
-		tu->qused++;
-	}
+	struct snd_timer_tread *r = snd_timer_user_new_record(tu);
+
+	if (r)
+		memcpy(r, tread, sizeof(*tread));
 }
 
 static void snd_timer_user_ccallback(struct snd_timer_instance *timeri,
@@ -1168,6 +1335,7 @@ static void snd_timer_user_ccallback(struct snd_timer_instance *timeri,
 	struct snd_timer_user *tu = timeri->callback_data;
 	struct snd_timer_tread r1;
 	unsigned long flags;
+	bool wake;
 
 	if (event >= SNDRV_TIMER_EVENT_START &&
 	    event <= SNDRV_TIMER_EVENT_PAUSE)
@@ -1179,9 +1347,10 @@ static void snd_timer_user_ccallback(struct snd_timer_instance *timeri,
 	r1.val = resolution;
 	spin_lock_irqsave(&tu->qlock, flags);
 	snd_timer_user_append_to_tqueue(tu, &r1);
+	wake = snd_timer_user_wake_now(tu, true);
 	spin_unlock_irqrestore(&tu->qlock, flags);
-	kill_fasync(&tu->fasync, SIGIO, POLL_IN);
-	wake_up(&tu->qchange_sleep);
+	if (wake)
+		snd_timer_user_wakeup(tu);
 }
 
 static void snd_timer_user_tinterrupt(struct snd_timer_instance *timeri,
@@ -1191,7 +1360,8 @@ static void snd_timer_user_tinterrupt(struct snd_timer_instance *timeri,
 	struct snd_timer_user *tu = timeri->callback_data;
 	struct snd_timer_tread *r, r1;
 	struct timespec tstamp;
-	int prev, append = 0;
+	int append = 0;
+	bool wake;
 
 	memset(&tstamp, 0, sizeof(tstamp));
 	spin_lock(&tu->qlock);
@@ -1219,15 +1389,12 @@ static void snd_timer_user_tinterrupt(struct snd_timer_instance *timeri,
 		goto __wake;
 	if (ticks == 0)
 		goto __wake;
-	if (tu->qused > 0) {
-		prev = tu->qtail == 0 ? tu->queue_size - 1 : tu->qtail - 1;
-		r = &tu->tqueue[prev];
-		if (r->event == SNDRV_TIMER_EVENT_TICK) {
-			r->tstamp = tstamp;
-			r->val += ticks;
-			append++;
-			goto __wake;
-		}
+	r = snd_timer_user_staged(tu);
+	if (r && r->event == SNDRV_TIMER_EVENT_TICK) {
+		r->tstamp = tstamp;
+		r->val += ticks;
+		append++;
+		goto __wake;
 	}
 	r1.event = SNDRV_TIMER_EVENT_TICK;
 	r1.tstamp = tstamp;
@@ -1235,11 +1402,49 @@ static void snd_timer_user_tinterrupt(struct snd_timer_instance *timeri,
 	snd_timer_user_append_to_tqueue(tu, &r1);
 	append++;
       __wake:
+	wake = append && snd_timer_user_wake_now(tu, false);
 	spin_unlock(&tu->qlock);
-	if (append == 0)
-		return;
-	kill_fasync(&tu->fasync, SIGIO, POLL_IN);
-	wake_up(&tu->qchange_sleep);
+	if (wake)
+		snd_timer_user_wakeup(tu);
+}
+
+/*
+ * (Re)allocate the queue buffer for queue_size records of the current
+ * read format.  An existing mapping keeps the old buffer alive but is
+ * no longer fed; user space has to mmap() again.
+ */
+static int snd_timer_user_alloc_queue(struct snd_timer_user *tu,
+				      int queue_size)
+{
+	struct snd_timer_mmap_queue *hdr, *old;
+	unsigned int slots = roundup_pow_of_two(queue_size);
+	size_t unit, bytes;
+
+	unit = tu->tread ? sizeof(struct snd_timer_tread) :
+			   sizeof(struct snd_timer_read);
+	bytes = PAGE_ALIGN(sizeof(*hdr) + slots * unit);
+	hdr = vmalloc_user(bytes);
+	if (hdr == NULL)
+		return -ENOMEM;
+	hdr->size = slots;
+	hdr->tread = tu->tread;
+	hdr->overrun = tu->overrun;
+
+	spin_lock_irq(&tu->qlock);
+	old = tu->qhdr;
+	tu->qhdr = hdr;
+	tu->qbytes = bytes;
+	tu->qmask = slots - 1;
+	tu->qtail = 0;
+	tu->queue_size = queue_size;
+	tu->queue = tu->tread ? NULL : (struct snd_timer_read *)(hdr + 1);
+	tu->tqueue = tu->tread ? (struct snd_timer_tread *)(hdr + 1) : NULL;
+	tu->qstaged = 0;
+	tu->qmapped = 0;
+	tu->qevents = 0;
+	spin_unlock_irq(&tu->qlock);
+	vfree(old);
+	return 0;
 }
 
 static int snd_timer_user_open(struct inode *inode, struct file *file)
@@ -1258,10 +1463,8 @@ static int snd_timer_user_open(struct inode *inode, struct file *file)
 	init_waitqueue_head(&tu->qchange_sleep);
 	mutex_init(&tu->tread_sem);
 	tu->ticks = 1;
-	tu->queue_size = 128;
-	tu->queue = kmalloc(tu->queue_size * sizeof(struct snd_timer_read),
-			    GFP_KERNEL);
-	if (tu->queue == NULL) {
+	tu->avail_min = 1;
+	if (snd_timer_user_alloc_queue(tu, 128) < 0) {
 		kfree(tu);
 		return -ENOMEM;
 	}
@@ -1278,8 +1481,7 @@ static int snd_timer_user_release(struct inode *inode, struct file *file)
 		file->private_data = NULL;
 		if (tu->timeri)
 			snd_timer_close(tu->timeri);
-		kfree(tu->queue);
-		kfree(tu->tqueue);
+		vfree(tu->qhdr);
 		kfree(tu);
 	}
 	return 0;
@@ -1531,21 +1733,7 @@ static int snd_timer_user_tselect(struct file *file,
 	if (err < 0)
 		goto __err;
 
-	kfree(tu->queue);
-	tu->queue = NULL;
-	kfree(tu->tqueue);
-	tu->tqueue = NULL;
-	if (tu->tread) {
-		tu->tqueue = kmalloc(tu->queue_size * sizeof(struct snd_timer_tread),
-				     GFP_KERNEL);
-		if (tu->tqueue == NULL)
-			err = -ENOMEM;
-	} else {
-		tu->queue = kmalloc(tu->queue_size * sizeof(struct snd_timer_read),
-				    GFP_KERNEL);
-		if (tu->queue == NULL)
-			err = -ENOMEM;
-	}
+	err = snd_timer_user_alloc_queue(tu, tu->queue_size);
 
       	if (err < 0) {
 		snd_timer_close(tu->timeri);
@@ -1599,8 +1787,6 @@ static int snd_timer_user_params(struct file *file,
 	struct snd_timer_user *tu;
 	struct snd_timer_params params;
 	struct snd_timer *t;
-	struct snd_timer_read *tr;
-	struct snd_timer_tread *ttr;
 	int err;
 
 	tu = file->private_data;
@@ -1649,27 +1835,15 @@ static int snd_timer_user_params(struct file *file,
 	if (params.flags & SNDRV_TIMER_PSFLG_EARLY_EVENT)
 		tu->timeri->flags |= SNDRV_TIMER_IFLG_EARLY_EVENT;
 	spin_unlock_irq(&t->lock);
+	mutex_lock(&tu->tread_sem);
 	if (params.queue_size > 0 &&
-	    (unsigned int)tu->queue_size != params.queue_size) {
-		if (tu->tread) {
-			ttr = kmalloc(params.queue_size * sizeof(*ttr),
-				      GFP_KERNEL);
-			if (ttr) {
-				kfree(tu->tqueue);
-				tu->queue_size = params.queue_size;
-				tu->tqueue = ttr;
-			}
-		} else {
-			tr = kmalloc(params.queue_size * sizeof(*tr),
-				     GFP_KERNEL);
-			if (tr) {
-				kfree(tu->queue);
-				tu->queue_size = params.queue_size;
-				tu->queue = tr;
-			}
-		}
-	}
-	tu->qhead = tu->qtail = tu->qused = 0;
+	    (unsigned int)tu->queue_size != params.queue_size)
+		snd_timer_user_alloc_queue(tu, params.queue_size);
+	spin_lock_irq(&tu->qlock);
+	tu->qtail = 0;
+	tu->qhdr->head = tu->qhdr->tail = 0;
+	tu->qstaged = 0;
+	tu->qevents = 0;
 	if (tu->timeri->flags & SNDRV_TIMER_IFLG_EARLY_EVENT) {
 		if (tu->tread) {
 			struct snd_timer_tread tread;
@@ -1679,13 +1853,14 @@ static int snd_timer_user_params(struct file *file,
 			tread.val = 0;
 			snd_timer_user_append_to_tqueue(tu, &tread);
 		} else {
-			struct snd_timer_read *r = &tu->queue[0];
+			struct snd_timer_read *r = snd_timer_user_new_record(tu);
 			r->resolution = 0;
 			r->ticks = 0;
-			tu->qused++;
-			tu->qtail++;
 		}
+		snd_timer_user_publish(tu);
 	}
+	spin_unlock_irq(&tu->qlock);
+	mutex_unlock(&tu->tread_sem);
 	tu->filter = params.filter;
 	tu->ticks = params.ticks;
 	err = 0;
@@ -1710,13 +1885,30 @@ static int snd_timer_user_status(struct file *file,
 	status.lost = tu->timeri->lost;
 	status.overrun = tu->overrun;
 	spin_lock_irq(&tu->qlock);
-	status.queue = tu->qused;
+	status.queue = snd_timer_user_queued(tu);
 	spin_unlock_irq(&tu->qlock);
 	if (copy_to_user(_status, &status, sizeof(status)))
 		return -EFAULT;
 	return 0;
 }
 
+static int snd_timer_user_queue_params(struct file *file,
+				       struct snd_timer_queue_params __user *_params)
+{
+	struct snd_timer_user *tu = file->private_data;
+	struct snd_timer_queue_params params;
+
+	if (copy_from_user(&params, _params, sizeof(params)))
+		return -EFAULT;
+	spin_lock_irq(&tu->qlock);
+	tu->avail_min = max(params.avail_min, 1U);
+	tu->max_delay_ns = (u64)params.max_delay_us * NSEC_PER_USEC;
+	tu->qfirst_ns = ktime_to_ns(ktime_get());
+	tu->qevents = 0;
+	spin_unlock_irq(&tu->qlock);
+	return 0;
+}
+
 static int snd_timer_user_start(struct file *file)
 {
 	int err;
@@ -1799,8 +1991,10 @@ static long snd_timer_user_ioctl(struct file *file, unsigned int cmd,
 			return -EFAULT;
 		}
 		tu->tread = xarg ? 1 : 0;
+		/* the queue buffer holds records of the new format */
+		xarg = snd_timer_user_alloc_queue(tu, tu->queue_size);
 		mutex_unlock(&tu->tread_sem);
-		return 0;
+		return xarg;
 	}
 	case SNDRV_TIMER_IOCTL_GINFO:
 		return snd_timer_user_ginfo(file, argp);
@@ -1816,6 +2010,8 @@ static long snd_timer_user_ioctl(struct file *file, unsigned int cmd,
 		return snd_timer_user_params(file, argp);
 	case SNDRV_TIMER_IOCTL_STATUS:
 		return snd_timer_user_status(file, argp);
+	case SNDRV_TIMER_IOCTL_QUEUE_PARAMS:
+		return snd_timer_user_queue_params(file, argp);
 	case SNDRV_TIMER_IOCTL_START:
 	case SNDRV_TIMER_IOCTL_START_OLD:
 		return snd_timer_user_start(file);
@@ -1840,70 +2036,79 @@ static int snd_timer_user_fasync(int fd, struct file * file, int on)
 	return fasync_helper(fd, file, on, &tu->fasync);
 }
 
+/*
+ * Number of records the reader can take; publishes the staged record if
+ * nothing else is left.  Taken once per read/poll, not per record.
+ */
+static unsigned int snd_timer_user_readable(struct snd_timer_user *tu)
+{
+	unsigned int avail;
+
+	spin_lock_irq(&tu->qlock);
+	avail = snd_timer_user_published(tu);
+	if (!avail && tu->qstaged) {
+		snd_timer_user_publish(tu);
+		avail = snd_timer_user_published(tu);
+	}
+	spin_unlock_irq(&tu->qlock);
+	return avail;
+}
+
 static ssize_t snd_timer_user_read(struct file *file, char __user *buffer,
 				   size_t count, loff_t *offset)
 {
 	struct snd_timer_user *tu;
-	long result = 0, unit;
-	int err = 0;
+	unsigned int head, avail, n, first;
+	long unit;
+	int err;
 
 	tu = file->private_data;
 	unit = tu->tread ? sizeof(struct snd_timer_tread) : sizeof(struct snd_timer_read);
-	spin_lock_irq(&tu->qlock);
-	while ((long)count - result >= unit) {
-		while (!tu->qused) {
-			wait_queue_t wait;
-
-			if ((file->f_flags & O_NONBLOCK) != 0 || result > 0) {
-				err = -EAGAIN;
-				break;
-			}
-
-			set_current_state(TASK_INTERRUPTIBLE);
-			init_waitqueue_entry(&wait, current);
-			add_wait_queue(&tu->qchange_sleep, &wait);
-
-			spin_unlock_irq(&tu->qlock);
-			schedule();
-			spin_lock_irq(&tu->qlock);
-
-			remove_wait_queue(&tu->qchange_sleep, &wait);
-
-			if (signal_pending(current)) {
-				err = -ERESTARTSYS;
-				break;
-			}
-		}
-
-		spin_unlock_irq(&tu->qlock);
+	if ((long)count < unit)
+		return 0;
+ again:
+	if (!snd_timer_user_readable(tu)) {
+		if (file->f_flags & O_NONBLOCK)
+			return -EAGAIN;
+		err = wait_event_interruptible(tu->qchange_sleep,
+					       snd_timer_user_readable(tu));
 		if (err < 0)
-			goto _error;
-
-		if (tu->tread) {
-			if (copy_to_user(buffer, &tu->tqueue[tu->qhead++],
-					 sizeof(struct snd_timer_tread))) {
-				err = -EFAULT;
-				goto _error;
-			}
-		} else {
-			if (copy_to_user(buffer, &tu->queue[tu->qhead++],
-					 sizeof(struct snd_timer_read))) {
-				err = -EFAULT;
-				goto _error;
-			}
-		}
-
-		tu->qhead %= tu->queue_size;
-
-		result += unit;
-		buffer += unit;
+			return err;
+	}
 
-		spin_lock_irq(&tu->qlock);
-		tu->qused--;
+	/*
+	 * Copy everything available in one go without qlock; the
+	 * producers only touch records past tail meanwhile.  TREAD
+	 * changes the record size under tread_sem.
+	 */
+	mutex_lock(&tu->tread_sem);
+	unit = tu->tread ? sizeof(struct snd_timer_tread) : sizeof(struct snd_timer_read);
+	if ((long)count < unit) {
+		mutex_unlock(&tu->tread_sem);
+		return 0;
 	}
-	spin_unlock_irq(&tu->qlock);
- _error:
-	return result > 0 ? result : err;
+	head = ACCESS_ONCE(tu->qhdr->head);
+	avail = min_t(unsigned int, snd_timer_user_published(tu),
+		      tu->queue_size);
+	smp_rmb();	/* tail before record contents */
+	n = min_t(unsigned int, avail, count / unit);
+	if (!n) {
+		/* raced with another reader */
+		mutex_unlock(&tu->tread_sem);
+		goto again;
+	}
+	first = min(n, tu->qmask + 1 - (head & tu->qmask));
+	err = 0;
+	if (copy_to_user(buffer, snd_timer_user_slot(tu, head), first * unit) ||
+	    copy_to_user(buffer + first * unit, snd_timer_user_slot(tu, 0),
+			 (n - first) * unit)) {
+		err = -EFAULT;
+	} else {
+		smp_mb();	/* done with the records before freeing them */
+		ACCESS_ONCE(tu->qhdr->head) = head + n;
+	}
+	mutex_unlock(&tu->tread_sem);
+	return err < 0 ? err : n * unit;
 }
 
 static unsigned int snd_timer_user_poll(struct file *file, poll_table * wait)
@@ -1916,12 +2121,40 @@ static unsigned int snd_timer_user_poll(struct file *file, poll_table * wait)
         poll_wait(file, &tu->qchange_sleep, wait);
 
 	mask = 0;
-	if (tu->qused)
+	if (snd_timer_user_readable(tu))
 		mask |= POLLIN | POLLRDNORM;
 
 	return mask;
 }
 
+/*
+ * Map the read queue (struct snd_timer_mmap_queue followed by the
+ * records) for syscall-free consumption.  Staged records are published
+ * right away while mapped.  The mapping is invalidated by SELECT and by
+ * PARAMS changing the queue size.
+ */
+static int snd_timer_user_mmap(struct file *file, struct vm_area_struct *area)
+{
+	struct snd_timer_user *tu = file->private_data;
+	int err;
+
+	mutex_lock(&tu->tread_sem);
+	if (area->vm_pgoff ||
+	    area->vm_end - area->vm_start > tu->qbytes) {
+		err = -EINVAL;
+	} else {
+		err = remap_vmalloc_range(area, tu->qhdr, 0);
+		if (!err) {
+			spin_lock_irq(&tu->qlock);
+			tu->qmapped = 1;
+			snd_timer_user_publish(tu);
+			spin_unlock_irq(&tu->qlock);
+		}
+	}
+	mutex_unlock(&tu->tread_sem);
+	return err;
+}
+
 #ifdef CONFIG_COMPAT
 #include "timer_compat.c"
 #else
@@ -1936,6 +2169,7 @@ static const struct file_operations snd_timer_f_ops =
 	.release =	snd_timer_user_release,
 	.llseek =	no_llseek,
 	.poll =		snd_timer_user_poll,
+	.mmap =		snd_timer_user_mmap,
 	.unlocked_ioctl =	snd_timer_user_ioctl,
 	.compat_ioctl =	snd_timer_user_ioctl_compat,
 	.fasync = 	snd_timer_user_fasync,
@@ -81,7 +81,7 @@ static int snd_timer_user_status_compat(struct file *file,
 	status.lost = tu->timeri->lost;
 	status.overrun = tu->overrun;
 	spin_lock_irq(&tu->qlock);
-	status.queue = tu->qused;
+	status.queue = snd_timer_user_queued(tu);
 	spin_unlock_irq(&tu->qlock);
 	if (copy_to_user(_status, &status, sizeof(status)))
 		return -EFAULT;
@@ -116,6 +116,7 @@ static long snd_timer_user_ioctl_compat(struct file *file, unsigned int cmd, uns
 	case SNDRV_TIMER_IOCTL_CONTINUE_OLD:
 	case SNDRV_TIMER_IOCTL_PAUSE:
 	case SNDRV_TIMER_IOCTL_PAUSE_OLD:
+	case SNDRV_TIMER_IOCTL_QUEUE_PARAMS:
 	case SNDRV_TIMER_IOCTL_NEXT_DEVICE:
 		return snd_timer_user_ioctl(file, cmd, (unsigned long)argp);
 	case SNDRV_TIMER_IOCTL_INFO32:
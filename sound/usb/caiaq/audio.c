@@ -20,6 +20,7 @@
 #include <linux/spinlock.h>
 #include <linux/slab.h>
 #include <linux/init.h>
+#include <linux/moduleparam.h>
 #include <linux/usb.h>
 #include <sound/core.h>
 #include <sound/pcm.h>
@@ -43,6 +44,10 @@
 #define MAKE_CHECKBYTE(cdev,stream,i) \
 	(stream << 1) | (~(i / (cdev->n_streams * BYTES_PER_SAMPLE_USB)) & 1)
 
+static bool reference_copy;
+module_param(reference_copy, bool, 0644);
+MODULE_PARM_DESC(reference_copy, "Use the byte-wise reference loops to (de)interleave the audio data.");
+
 static struct snd_pcm_hardware snd_usb_caiaq_pcm_hardware = {
 	.info 		= (SNDRV_PCM_INFO_MMAP | SNDRV_PCM_INFO_INTERLEAVED |
 			   SNDRV_PCM_INFO_BLOCK_TRANSFER),
@@ -374,9 +379,14 @@ static void check_for_elapsed_periods(struct snd_usb_caiaqdev *cdev,
 	}
 }
 
-static void read_in_urb_mode0(struct snd_usb_caiaqdev *cdev,
-			      const struct urb *urb,
-			      const struct usb_iso_packet_descriptor *iso)
+/*
+ * Byte-wise reference implementations of the (de)interleaving.  They are
+ * used when the reference_copy option is set, and for packets that don't
+ * consist of whole blocks, which the block copies below don't handle.
+ */
+static void read_in_urb_mode0_ref(struct snd_usb_caiaqdev *cdev,
+				  const struct urb *urb,
+				  const struct usb_iso_packet_descriptor *iso)
 {
 	unsigned char *usb_buf = urb->transfer_buffer + iso->offset;
 	struct snd_pcm_substream *sub;
@@ -402,9 +412,9 @@ static void read_in_urb_mode0(struct snd_usb_caiaqdev *cdev,
 	}
 }
 
-static void read_in_urb_mode2(struct snd_usb_caiaqdev *cdev,
-			      const struct urb *urb,
-			      const struct usb_iso_packet_descriptor *iso)
+static void read_in_urb_mode2_ref(struct snd_usb_caiaqdev *cdev,
+				  const struct urb *urb,
+				  const struct usb_iso_packet_descriptor *iso)
 {
 	unsigned char *usb_buf = urb->transfer_buffer + iso->offset;
 	unsigned char check_byte;
@@ -449,9 +459,9 @@ static void read_in_urb_mode2(struct snd_usb_caiaqdev *cdev,
 	}
 }
 
-static void read_in_urb_mode3(struct snd_usb_caiaqdev *cdev,
-			      const struct urb *urb,
-			      const struct usb_iso_packet_descriptor *iso)
+static void read_in_urb_mode3_ref(struct snd_usb_caiaqdev *cdev,
+				  const struct urb *urb,
+				  const struct usb_iso_packet_descriptor *iso)
 {
 	unsigned char *usb_buf = urb->transfer_buffer + iso->offset;
 	struct device *dev = caiaqdev_to_dev(cdev);
@@ -505,41 +515,9 @@ static void read_in_urb_mode3(struct snd_usb_caiaqdev *cdev,
 		cdev->first_packet--;
 }
 
-static void read_in_urb(struct snd_usb_caiaqdev *cdev,
-			const struct urb *urb,
-			const struct usb_iso_packet_descriptor *iso)
-{
-	struct device *dev = caiaqdev_to_dev(cdev);
-
-	if (!cdev->streaming)
-		return;
-
-	if (iso->actual_length < cdev->bpp)
-		return;
-
-	switch (cdev->spec.data_alignment) {
-	case 0:
-		read_in_urb_mode0(cdev, urb, iso);
-		break;
-	case 2:
-		read_in_urb_mode2(cdev, urb, iso);
-		break;
-	case 3:
-		read_in_urb_mode3(cdev, urb, iso);
-		break;
-	}
-
-	if ((cdev->input_panic || cdev->output_panic) && !cdev->warned) {
-		dev_warn(dev, "streaming error detected %s %s\n",
-				cdev->input_panic ? "(input)" : "",
-				cdev->output_panic ? "(output)" : "");
-		cdev->warned = 1;
-	}
-}
-
-static void fill_out_urb_mode_0(struct snd_usb_caiaqdev *cdev,
-				struct urb *urb,
-				const struct usb_iso_packet_descriptor *iso)
+static void fill_out_urb_mode_0_ref(struct snd_usb_caiaqdev *cdev,
+				    struct urb *urb,
+				    const struct usb_iso_packet_descriptor *iso)
 {
 	unsigned char *usb_buf = urb->transfer_buffer + iso->offset;
 	struct snd_pcm_substream *sub;
@@ -571,9 +549,9 @@ static void fill_out_urb_mode_0(struct snd_usb_caiaqdev *cdev,
 	}
 }
 
-static void fill_out_urb_mode_3(struct snd_usb_caiaqdev *cdev,
-				struct urb *urb,
-				const struct usb_iso_packet_descriptor *iso)
+static void fill_out_urb_mode_3_ref(struct snd_usb_caiaqdev *cdev,
+				    struct urb *urb,
+				    const struct usb_iso_packet_descriptor *iso)
 {
 	unsigned char *usb_buf = urb->transfer_buffer + iso->offset;
 	int stream, i;
@@ -614,17 +592,351 @@ static void fill_out_urb_mode_3(struct snd_usb_caiaqdev *cdev,
 	}
 }
 
+/*
+ * Block copy kernels for the (de)interleaving below.  In a packet, the data
+ * of one stream comes in groups of @width bytes, each taken from the USB
+ * buffer at the offsets listed in @map; consecutive groups are @stride bytes
+ * apart.  The ring buffer wrap is resolved once per packet instead of being
+ * checked for every byte.
+ */
+static void capture_block(struct snd_usb_caiaqdev *cdev, int stream,
+			  const unsigned char *src, unsigned int groups,
+			  const unsigned char *map, unsigned int width,
+			  unsigned int stride)
+{
+	struct snd_pcm_runtime *rt = cdev->sub_capture[stream]->runtime;
+	unsigned int sz = frames_to_bytes(rt, rt->buffer_size);
+	unsigned int pos = cdev->audio_in_buf_pos[stream];
+	unsigned int run, g, k;
+	unsigned char *dst;
+
+	cdev->period_in_count[stream] += groups * width;
+
+	while (groups) {
+		run = min(groups, (sz - pos) / width);
+		if (!run) {
+			/* misaligned tail, can't happen with 6-byte frames */
+			pos = 0;
+			continue;
+		}
+
+		dst = rt->dma_area + pos;
+		if (!src) {
+			/* input panic: record silence */
+			memset(dst, 0, run * width);
+		} else {
+			for (g = 0; g < run; g++, src += stride, dst += width)
+				for (k = 0; k < width; k++)
+					dst[k] = src[map[k]];
+		}
+
+		groups -= run;
+		pos += run * width;
+		if (pos >= sz)
+			pos = 0;
+	}
+
+	cdev->audio_in_buf_pos[stream] = pos;
+}
+
+static void playback_block(struct snd_usb_caiaqdev *cdev, int stream,
+			   unsigned char *dst, unsigned int groups,
+			   const unsigned char *map, unsigned int width,
+			   unsigned int stride)
+{
+	struct snd_pcm_substream *sub = cdev->sub_playback[stream];
+	struct snd_pcm_runtime *rt;
+	unsigned int sz, pos, run, g, k;
+	const unsigned char *src;
+
+	if (!sub) {
+		for (g = 0; g < groups; g++, dst += stride)
+			for (k = 0; k < width; k++)
+				dst[map[k]] = 0;
+		return;
+	}
+
+	rt = sub->runtime;
+	sz = frames_to_bytes(rt, rt->buffer_size);
+	pos = cdev->audio_out_buf_pos[stream];
+	cdev->period_out_count[stream] += groups * width;
+
+	while (groups) {
+		run = min(groups, (sz - pos) / width);
+		if (!run) {
+			pos = 0;
+			continue;
+		}
+
+		src = rt->dma_area + pos;
+		for (g = 0; g < run; g++, dst += stride, src += width)
+			for (k = 0; k < width; k++)
+				dst[map[k]] = src[k];
+
+		groups -= run;
+		pos += run * width;
+		if (pos >= sz)
+			pos = 0;
+	}
+
+	cdev->audio_out_buf_pos[stream] = pos;
+}
+
+/* mode 3 layout: 3 audio data bytes, followed by 1 check byte, per channel */
+static const unsigned char mode3_map[CHANNELS_PER_STREAM * BYTES_PER_SAMPLE] = {
+	0, 1, 2, 4, 5, 6
+};
+
+static void read_in_urb_mode0(struct snd_usb_caiaqdev *cdev,
+			      const struct urb *urb,
+			      const struct usb_iso_packet_descriptor *iso)
+{
+	static const unsigned char map[1] = { 0 };
+	unsigned char *usb_buf = urb->transfer_buffer + iso->offset;
+	unsigned int groups = iso->actual_length / cdev->n_streams;
+	int stream;
+
+	if (all_substreams_zero(cdev->sub_capture))
+		return;
+
+	/* one byte per stream, round robin */
+	for (stream = 0; stream < cdev->n_streams; stream++)
+		if (cdev->sub_capture[stream])
+			capture_block(cdev, stream, usb_buf + stream, groups,
+				      map, 1, cdev->n_streams);
+}
+
+static void read_in_urb_mode2(struct snd_usb_caiaqdev *cdev,
+			      const struct urb *urb,
+			      const struct usb_iso_packet_descriptor *iso)
+{
+	unsigned char *usb_buf = urb->transfer_buffer + iso->offset;
+	unsigned int block = cdev->n_streams * BYTES_PER_SAMPLE_USB;
+	unsigned int blocks = iso->actual_length / block;
+	unsigned char check_byte, map[BYTES_PER_SAMPLE];
+	unsigned int b, i;
+	int stream;
+
+	/*
+	 * each block holds one check byte per stream, followed by
+	 * BYTES_PER_SAMPLE data bytes per stream, round robin
+	 */
+	for (b = cdev->first_packet ? 1 : 0; b < blocks; b++) {
+		for (stream = 0; stream < cdev->n_streams; stream++) {
+			i = b * block + stream;
+			check_byte = MAKE_CHECKBYTE(cdev, stream, i);
+
+			if ((usb_buf[i] & 0x3f) != check_byte)
+				cdev->input_panic = 1;
+
+			if (usb_buf[i] & 0x80)
+				cdev->output_panic = 1;
+		}
+	}
+	cdev->first_packet = 0;
+
+	for (i = 0; i < BYTES_PER_SAMPLE; i++)
+		map[i] = i * cdev->n_streams;
+
+	for (stream = 0; stream < cdev->n_streams; stream++)
+		if (cdev->sub_capture[stream])
+			capture_block(cdev, stream, cdev->input_panic ? NULL :
+				      usb_buf + cdev->n_streams + stream,
+				      blocks, map, BYTES_PER_SAMPLE, block);
+}
+
+static void read_in_urb_mode3(struct snd_usb_caiaqdev *cdev,
+			      const struct urb *urb,
+			      const struct usb_iso_packet_descriptor *iso)
+{
+	unsigned char *usb_buf = urb->transfer_buffer + iso->offset;
+	struct device *dev = caiaqdev_to_dev(cdev);
+	unsigned int block = cdev->n_streams *
+			     CHANNELS_PER_STREAM * BYTES_PER_SAMPLE_USB;
+	unsigned int blocks = iso->actual_length / block;
+	unsigned int b, i;
+	int stream, c;
+
+	/* paranoia check */
+	if (iso->actual_length % (BYTES_PER_SAMPLE_USB * CHANNELS_PER_STREAM))
+		return;
+
+	/* verify the check bytes of the whole packet first */
+	for (b = 0; b < blocks && !cdev->first_packet; b++) {
+		for (stream = 0; stream < cdev->n_streams; stream++) {
+			for (c = 0; c < CHANNELS_PER_STREAM; c++) {
+				i = b * block +
+				    (stream * CHANNELS_PER_STREAM + c) *
+				    BYTES_PER_SAMPLE_USB + BYTES_PER_SAMPLE;
+
+				if (usb_buf[i] == ((stream << 1) | c))
+					continue;
+
+				if (!cdev->input_panic)
+					dev_warn(dev, " EXPECTED: %02x got %02x, c %d, stream %d, i %d\n",
+						 ((stream << 1) | c), usb_buf[i], c, stream, i);
+				cdev->input_panic = 1;
+			}
+		}
+	}
+
+	if (!cdev->input_panic) {
+		for (stream = 0; stream < cdev->n_streams; stream++)
+			if (cdev->sub_capture[stream])
+				capture_block(cdev, stream,
+					      usb_buf + stream * CHANNELS_PER_STREAM *
+							BYTES_PER_SAMPLE_USB,
+					      blocks, mode3_map,
+					      sizeof(mode3_map), block);
+	}
+
+	if (cdev->first_packet > 0)
+		cdev->first_packet--;
+}
+
+/* a trailing partial block is left to the reference loops */
+static inline bool use_reference_copy(unsigned int len, unsigned int block)
+{
+	return reference_copy || len % block;
+}
+
+static void read_in_urb(struct snd_usb_caiaqdev *cdev,
+			const struct urb *urb,
+			const struct usb_iso_packet_descriptor *iso)
+{
+	struct device *dev = caiaqdev_to_dev(cdev);
+
+	if (!cdev->streaming)
+		return;
+
+	if (iso->actual_length < cdev->bpp)
+		return;
+
+	switch (cdev->spec.data_alignment) {
+	case 0:
+		if (use_reference_copy(iso->actual_length, cdev->n_streams))
+			read_in_urb_mode0_ref(cdev, urb, iso);
+		else
+			read_in_urb_mode0(cdev, urb, iso);
+		break;
+	case 2:
+		if (use_reference_copy(iso->actual_length,
+				       cdev->n_streams * BYTES_PER_SAMPLE_USB))
+			read_in_urb_mode2_ref(cdev, urb, iso);
+		else
+			read_in_urb_mode2(cdev, urb, iso);
+		break;
+	case 3:
+		if (use_reference_copy(iso->actual_length, cdev->n_streams *
+				       CHANNELS_PER_STREAM * BYTES_PER_SAMPLE_USB))
+			read_in_urb_mode3_ref(cdev, urb, iso);
+		else
+			read_in_urb_mode3(cdev, urb, iso);
+		break;
+	}
+
+	if ((cdev->input_panic || cdev->output_panic) && !cdev->warned) {
+		dev_warn(dev, "streaming error detected %s %s\n",
+				cdev->input_panic ? "(input)" : "",
+				cdev->output_panic ? "(output)" : "");
+		cdev->warned = 1;
+	}
+}
+
+static void fill_out_urb_mode_0(struct snd_usb_caiaqdev *cdev,
+				struct urb *urb,
+				const struct usb_iso_packet_descriptor *iso)
+{
+	static const unsigned char map[1] = { 0 };
+	unsigned char *usb_buf = urb->transfer_buffer + iso->offset;
+	unsigned int block, blocks, b, i;
+	unsigned char map2[BYTES_PER_SAMPLE];
+	int stream;
+
+	if (cdev->spec.data_alignment != 2) {
+		/* one byte per stream, round robin */
+		for (stream = 0; stream < cdev->n_streams; stream++)
+			playback_block(cdev, stream, usb_buf + stream,
+				       iso->length / cdev->n_streams,
+				       map, 1, cdev->n_streams);
+		return;
+	}
+
+	/*
+	 * mode 2: each block carries two rounds of data bytes, one round of
+	 * check bytes and another round of data bytes
+	 */
+	block = cdev->n_streams * BYTES_PER_SAMPLE_USB;
+	blocks = iso->length / block;
+
+	map2[0] = 0;
+	map2[1] = cdev->n_streams;
+	map2[2] = cdev->n_streams * 3;
+
+	for (stream = 0; stream < cdev->n_streams; stream++)
+		playback_block(cdev, stream, usb_buf + stream, blocks,
+			       map2, BYTES_PER_SAMPLE, block);
+
+	/* fill in the check bytes */
+	for (b = 0; b < blocks; b++)
+		for (stream = 0; stream < cdev->n_streams; stream++) {
+			i = b * block + cdev->n_streams * 2 + stream;
+			usb_buf[i] = MAKE_CHECKBYTE(cdev, stream, i);
+		}
+}
+
+static void fill_out_urb_mode_3(struct snd_usb_caiaqdev *cdev,
+				struct urb *urb,
+				const struct usb_iso_packet_descriptor *iso)
+{
+	unsigned char *usb_buf = urb->transfer_buffer + iso->offset;
+	unsigned int block = cdev->n_streams *
+			     CHANNELS_PER_STREAM * BYTES_PER_SAMPLE_USB;
+	unsigned int blocks = iso->length / block;
+	unsigned char *p;
+	unsigned int b;
+	int stream, c;
+
+	for (stream = 0; stream < cdev->n_streams; stream++)
+		playback_block(cdev, stream,
+			       usb_buf + stream * CHANNELS_PER_STREAM *
+					 BYTES_PER_SAMPLE_USB,
+			       blocks, mode3_map, sizeof(mode3_map), block);
+
+	/* fill in the check byte pattern */
+	for (b = 0; b < blocks; b++) {
+		p = usb_buf + b * block + BYTES_PER_SAMPLE;
+		for (stream = 0; stream < cdev->n_streams; stream++)
+			for (c = 0; c < CHANNELS_PER_STREAM; c++) {
+				*p = (stream << 1) | c;
+				p += BYTES_PER_SAMPLE_USB;
+			}
+	}
+}
+
 static inline void fill_out_urb(struct snd_usb_caiaqdev *cdev,
 				struct urb *urb,
 				const struct usb_iso_packet_descriptor *iso)
 {
+	unsigned int block;
+
 	switch (cdev->spec.data_alignment) {
 	case 0:
 	case 2:
-		fill_out_urb_mode_0(cdev, urb, iso);
+		block = cdev->n_streams;
+		if (cdev->spec.data_alignment == 2)
+			block *= BYTES_PER_SAMPLE_USB;
+		if (use_reference_copy(iso->length, block))
+			fill_out_urb_mode_0_ref(cdev, urb, iso);
+		else
+			fill_out_urb_mode_0(cdev, urb, iso);
 		break;
 	case 3:
-		fill_out_urb_mode_3(cdev, urb, iso);
+		if (use_reference_copy(iso->length, cdev->n_streams *
+				       CHANNELS_PER_STREAM * BYTES_PER_SAMPLE_USB))
+			fill_out_urb_mode_3_ref(cdev, urb, iso);
+		else
+			fill_out_urb_mode_3(cdev, urb, iso);
 		break;
 	}
 }
@@ -83,6 +83,9 @@ static int nrpacks = 8;		/* max. number of packets per urb */
 static int device_setup[SNDRV_CARDS]; /* device parameter for this card */
 static bool ignore_ctl_error;
 static bool autoclock = true;
+static bool fast_resume;
+static int aggregate[SNDRV_CARDS] = { [0 ... (SNDRV_CARDS-1)] = -1 };
+static unsigned int ctl_poll_interval;
 
 module_param_array(index, int, NULL, 0444);
 MODULE_PARM_DESC(index, "Index value for the USB audio adapter.");
@@ -103,6 +106,12 @@ MODULE_PARM_DESC(ignore_ctl_error,
 		 "Ignore errors from USB controller for mixer interfaces.");
 module_param(autoclock, bool, 0444);
 MODULE_PARM_DESC(autoclock, "Enable auto-clock selection for UAC2 devices (default: yes).");
+module_param(fast_resume, bool, 0444);
+MODULE_PARM_DESC(fast_resume, "Restore running streams directly on system resume (default: no).");
+module_param_array(aggregate, int, NULL, 0444);
+MODULE_PARM_DESC(aggregate, "Card number providing the playback feedback for this card (-1 = own).");
+module_param(ctl_poll_interval, uint, 0444);
+MODULE_PARM_DESC(ctl_poll_interval, "Min. interval between meter poll requests in ms (0 = no limit).");
 
 /*
  * we keep the snd_usb_audio_t instances by ourselves for merging
@@ -113,6 +122,48 @@ static DEFINE_MUTEX(register_mutex);
 static struct snd_usb_audio *usb_chip[SNDRV_CARDS];
 static struct usb_driver usb_audio_driver;
 
+/*
+ * slave the data endpoint @ep to the running sync endpoint of the card
+ * given by the 'aggregate' option of this chip.  the lookup and the link
+ * are done under register_mutex, so that the master endpoint can't be
+ * freed by a disconnect meanwhile; whether it still runs is checked again
+ * under aggregate_lock by snd_usb_endpoint_link_aggregate().
+ * returns -ENODEV if the master card isn't playing back.
+ */
+int snd_usb_link_aggregate_master(struct snd_usb_audio *chip,
+				  struct snd_usb_endpoint *ep)
+{
+	struct snd_usb_audio *master = NULL;
+	struct snd_usb_endpoint *mep;
+	int i, err = -ENODEV;
+
+	if (chip->aggregate < 0)
+		return 0;
+
+	mutex_lock(&register_mutex);
+	for (i = 0; i < SNDRV_CARDS; i++) {
+		if (usb_chip[i] && usb_chip[i] != chip &&
+		    usb_chip[i]->card->number == chip->aggregate) {
+			master = usb_chip[i];
+			break;
+		}
+	}
+	if (master && !master->shutdown) {
+		mutex_lock(&master->mutex);
+		list_for_each_entry(mep, &master->ep_list, list) {
+			if (mep->use_count &&
+			    mep->type == SND_USB_ENDPOINT_TYPE_SYNC) {
+				err = snd_usb_endpoint_link_aggregate(ep, mep);
+				break;
+			}
+		}
+		mutex_unlock(&master->mutex);
+	}
+	mutex_unlock(&register_mutex);
+
+	return err;
+}
+
 /*
  * disconnect streams
  * called from snd_usb_audio_disconnect()
@@ -370,12 +421,17 @@ static int snd_usb_audio_create(struct usb_device *dev, int idx,
 
 	mutex_init(&chip->mutex);
 	init_rwsem(&chip->shutdown_rwsem);
+	spin_lock_init(&chip->ctl_lock);
+	init_waitqueue_head(&chip->ctl_wait);
 	chip->index = idx;
 	chip->dev = dev;
 	chip->card = card;
 	chip->setup = device_setup[idx];
 	chip->nrpacks = nrpacks;
 	chip->autoclock = autoclock;
+	chip->aggregate = aggregate[idx];
+	chip->ctl_poll_interval = ctl_poll_interval;
+	chip->fast_resume = fast_resume;
 	chip->probing = 1;
 
 	chip->usb_id = USB_ID(le16_to_cpu(dev->descriptor.idVendor),
@@ -589,6 +645,11 @@ static void snd_usb_audio_disconnect(struct usb_device *dev,
 		return;
 
 	card = chip->card;
+	/* control requests may wait in the scheduler with shutdown_rwsem held */
+	spin_lock_irq(&chip->ctl_lock);
+	chip->ctl_shutdown = true;
+	spin_unlock_irq(&chip->ctl_lock);
+	wake_up_all(&chip->ctl_wait);
 	down_write(&chip->shutdown_rwsem);
 	chip->shutdown = 1;
 	up_write(&chip->shutdown_rwsem);
@@ -649,7 +710,7 @@ int snd_usb_autoresume(struct snd_usb_audio *chip)
 	int err = -ENODEV;
 
 	down_read(&chip->shutdown_rwsem);
-	if (chip->probing)
+	if (chip->probing || chip->in_pm)
 		err = 0;
 	else if (!chip->shutdown)
 		err = usb_autopm_get_interface(chip->pm_intf);
@@ -661,7 +722,7 @@ int snd_usb_autoresume(struct snd_usb_audio *chip)
 void snd_usb_autosuspend(struct snd_usb_audio *chip)
 {
 	down_read(&chip->shutdown_rwsem);
-	if (!chip->shutdown && !chip->probing)
+	if (!chip->shutdown && !chip->probing && !chip->in_pm)
 		usb_autopm_put_interface(chip->pm_intf);
 	up_read(&chip->shutdown_rwsem);
 }
@@ -699,9 +760,10 @@ static int usb_audio_suspend(struct usb_interface *intf, pm_message_t message)
 	return 0;
 }
 
-static int usb_audio_resume(struct usb_interface *intf)
+static int __usb_audio_resume(struct usb_interface *intf, bool reset_resume)
 {
 	struct snd_usb_audio *chip = usb_get_intfdata(intf);
+	struct snd_usb_stream *as;
 	struct usb_mixer_interface *mixer;
 	int err = 0;
 
@@ -709,26 +771,48 @@ static int usb_audio_resume(struct usb_interface *intf)
 		return 0;
 	if (--chip->num_suspended_intf)
 		return 0;
+
+	chip->in_pm = true;
 	/*
 	 * ALSA leaves material resumption to user space
-	 * we just notify and restart the mixers
+	 * we just notify and restart the mixers; with fast_resume, the
+	 * streams are set up again here so that user space only needs
+	 * to issue snd_pcm_resume()
 	 */
 	list_for_each_entry(mixer, &chip->mixer_list, list) {
-		err = snd_usb_mixer_activate(mixer);
+		err = snd_usb_mixer_activate(mixer, reset_resume ||
+					     (chip->fast_resume &&
+					      !chip->autosuspended));
 		if (err < 0)
 			goto err_out;
 	}
 
+	if (chip->fast_resume && !chip->autosuspended)
+		list_for_each_entry(as, &chip->pcm_list, list)
+			snd_usb_pcm_resume(as);
+
 	if (!chip->autosuspended)
 		snd_power_change_state(chip->card, SNDRV_CTL_POWER_D0);
 	chip->autosuspended = 0;
 
 err_out:
+	chip->in_pm = false;
 	return err;
 }
+
+static int usb_audio_resume(struct usb_interface *intf)
+{
+	return __usb_audio_resume(intf, false);
+}
+
+static int usb_audio_reset_resume(struct usb_interface *intf)
+{
+	return __usb_audio_resume(intf, true);
+}
 #else
 #define usb_audio_suspend	NULL
 #define usb_audio_resume	NULL
+#define usb_audio_reset_resume	NULL
 #endif		/* CONFIG_PM */
 
 static struct usb_device_id usb_audio_ids [] = {
@@ -750,6 +834,7 @@ static struct usb_driver usb_audio_driver = {
 	.disconnect =	usb_audio_disconnect,
 	.suspend =	usb_audio_suspend,
 	.resume =	usb_audio_resume,
+	.reset_resume =	usb_audio_reset_resume,
 	.id_table =	usb_audio_ids,
 	.supports_autosuspend = 1,
 };
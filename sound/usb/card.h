@@ -64,6 +64,12 @@ struct snd_usb_endpoint {
 	struct snd_usb_endpoint *sync_master;
 	struct snd_usb_endpoint *sync_slave;
 
+	/* cross-card feedback (aggregate mode), protected by aggregate_lock */
+	struct snd_usb_endpoint *aggregate_master;
+	bool aggregate_active;		/* the master is running */
+	struct list_head aggregate_slaves;
+	struct list_head aggregate_list;
+
 	struct snd_urb_ctx urb[MAX_URBS];
 
 	struct snd_usb_packet_info {
@@ -99,6 +105,14 @@ struct snd_usb_endpoint {
 	int skip_packets;		/* quirks for devices to ignore the first n packets
 					   in a stream */
 
+	/* statistics, reset at each start of the endpoint */
+	unsigned long stat_start;	/* jiffies at start */
+	unsigned int stat_urbs;		/* completed urbs */
+	unsigned int stat_packet_errors; /* iso packets with error status */
+	unsigned int stat_submit_errors; /* failed urb resubmissions */
+	u64 stat_complete_ns;		/* total time spent in the completion */
+	unsigned int stat_complete_max_ns; /* longest completion */
+
 	spinlock_t lock;
 	struct list_head list;
 };
@@ -143,6 +157,8 @@ struct snd_usb_substream {
 	int last_frame_number;          /* stored frame number */
 	int last_delay;                 /* stored delay */
 
+	unsigned int stat_xruns;	/* recoveries from xrun since open */
+
 	struct {
 		int marker;
 		int channel;
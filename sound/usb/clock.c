@@ -87,12 +87,13 @@ static int uac_clock_selector_get_val(struct snd_usb_audio *chip, int selector_i
 	unsigned char buf;
 	int ret;
 
-	ret = snd_usb_ctl_msg(chip->dev, usb_rcvctrlpipe(chip->dev, 0),
-			      UAC2_CS_CUR,
-			      USB_RECIP_INTERFACE | USB_TYPE_CLASS | USB_DIR_IN,
-			      UAC2_CX_CLOCK_SELECTOR << 8,
-			      snd_usb_ctrl_intf(chip) | (selector_id << 8),
-			      &buf, sizeof(buf));
+	ret = snd_usb_ctl_msg_prio(chip, SND_USB_CTL_PRIO_STREAM,
+				   usb_rcvctrlpipe(chip->dev, 0),
+				   UAC2_CS_CUR,
+				   USB_RECIP_INTERFACE | USB_TYPE_CLASS | USB_DIR_IN,
+				   UAC2_CX_CLOCK_SELECTOR << 8,
+				   snd_usb_ctrl_intf(chip) | (selector_id << 8),
+				   &buf, sizeof(buf));
 
 	if (ret < 0)
 		return ret;
@@ -105,12 +106,13 @@ static int uac_clock_selector_set_val(struct snd_usb_audio *chip, int selector_i
 {
 	int ret;
 
-	ret = snd_usb_ctl_msg(chip->dev, usb_sndctrlpipe(chip->dev, 0),
-			      UAC2_CS_CUR,
-			      USB_RECIP_INTERFACE | USB_TYPE_CLASS | USB_DIR_OUT,
-			      UAC2_CX_CLOCK_SELECTOR << 8,
-			      snd_usb_ctrl_intf(chip) | (selector_id << 8),
-			      &pin, sizeof(pin));
+	ret = snd_usb_ctl_msg_prio(chip, SND_USB_CTL_PRIO_STREAM,
+				   usb_sndctrlpipe(chip->dev, 0),
+				   UAC2_CS_CUR,
+				   USB_RECIP_INTERFACE | USB_TYPE_CLASS | USB_DIR_OUT,
+				   UAC2_CX_CLOCK_SELECTOR << 8,
+				   snd_usb_ctrl_intf(chip) | (selector_id << 8),
+				   &pin, sizeof(pin));
 	if (ret < 0)
 		return ret;
 
@@ -151,11 +153,12 @@ static bool uac_clock_source_is_valid(struct snd_usb_audio *chip, int source_id)
 				      UAC2_CS_CONTROL_CLOCK_VALID - 1))
 		return 1;
 
-	err = snd_usb_ctl_msg(dev, usb_rcvctrlpipe(dev, 0), UAC2_CS_CUR,
-			      USB_TYPE_CLASS | USB_RECIP_INTERFACE | USB_DIR_IN,
-			      UAC2_CS_CONTROL_CLOCK_VALID << 8,
-			      snd_usb_ctrl_intf(chip) | (source_id << 8),
-			      &data, sizeof(data));
+	err = snd_usb_ctl_msg_prio(chip, SND_USB_CTL_PRIO_STREAM,
+				   usb_rcvctrlpipe(dev, 0), UAC2_CS_CUR,
+				   USB_TYPE_CLASS | USB_RECIP_INTERFACE | USB_DIR_IN,
+				   UAC2_CS_CONTROL_CLOCK_VALID << 8,
+				   snd_usb_ctrl_intf(chip) | (source_id << 8),
+				   &data, sizeof(data));
 
 	if (err < 0) {
 		snd_printk(KERN_WARNING "%s(): cannot get clock validity for id %d\n",
@@ -292,19 +295,21 @@ static int set_sample_rate_v1(struct snd_usb_audio *chip, int iface,
 	data[0] = rate;
 	data[1] = rate >> 8;
 	data[2] = rate >> 16;
-	if ((err = snd_usb_ctl_msg(dev, usb_sndctrlpipe(dev, 0), UAC_SET_CUR,
-				   USB_TYPE_CLASS | USB_RECIP_ENDPOINT | USB_DIR_OUT,
-				   UAC_EP_CS_ATTR_SAMPLE_RATE << 8, ep,
-				   data, sizeof(data))) < 0) {
+	if ((err = snd_usb_ctl_msg_prio(chip, SND_USB_CTL_PRIO_STREAM,
+					usb_sndctrlpipe(dev, 0), UAC_SET_CUR,
+					USB_TYPE_CLASS | USB_RECIP_ENDPOINT | USB_DIR_OUT,
+					UAC_EP_CS_ATTR_SAMPLE_RATE << 8, ep,
+					data, sizeof(data))) < 0) {
 		snd_printk(KERN_ERR "%d:%d:%d: cannot set freq %d to ep %#x\n",
 			   dev->devnum, iface, fmt->altsetting, rate, ep);
 		return err;
 	}
 
-	if ((err = snd_usb_ctl_msg(dev, usb_rcvctrlpipe(dev, 0), UAC_GET_CUR,
-				   USB_TYPE_CLASS | USB_RECIP_ENDPOINT | USB_DIR_IN,
-				   UAC_EP_CS_ATTR_SAMPLE_RATE << 8, ep,
-				   data, sizeof(data))) < 0) {
+	if ((err = snd_usb_ctl_msg_prio(chip, SND_USB_CTL_PRIO_STREAM,
+					usb_rcvctrlpipe(dev, 0), UAC_GET_CUR,
+					USB_TYPE_CLASS | USB_RECIP_ENDPOINT | USB_DIR_IN,
+					UAC_EP_CS_ATTR_SAMPLE_RATE << 8, ep,
+					data, sizeof(data))) < 0) {
 		snd_printk(KERN_WARNING "%d:%d:%d: cannot get freq at ep %#x\n",
 			   dev->devnum, iface, fmt->altsetting, ep);
 		return 0; /* some devices don't support reading */
@@ -326,11 +331,12 @@ static int get_sample_rate_v2(struct snd_usb_audio *chip, int iface,
 	__le32 data;
 	int err;
 
-	err = snd_usb_ctl_msg(dev, usb_rcvctrlpipe(dev, 0), UAC2_CS_CUR,
-			      USB_TYPE_CLASS | USB_RECIP_INTERFACE | USB_DIR_IN,
-			      UAC2_CS_CONTROL_SAM_FREQ << 8,
-			      snd_usb_ctrl_intf(chip) | (clock << 8),
-			      &data, sizeof(data));
+	err = snd_usb_ctl_msg_prio(chip, SND_USB_CTL_PRIO_STREAM,
+				   usb_rcvctrlpipe(dev, 0), UAC2_CS_CUR,
+				   USB_TYPE_CLASS | USB_RECIP_INTERFACE | USB_DIR_IN,
+				   UAC2_CS_CONTROL_SAM_FREQ << 8,
+				   snd_usb_ctrl_intf(chip) | (clock << 8),
+				   &data, sizeof(data));
 	if (err < 0) {
 		snd_printk(KERN_WARNING "%d:%d:%d: cannot get freq (v2): err %d\n",
 			   dev->devnum, iface, altsetting, err);
@@ -363,11 +369,12 @@ static int set_sample_rate_v2(struct snd_usb_audio *chip, int iface,
 	writeable = uac2_control_is_writeable(cs_desc->bmControls, UAC2_CS_CONTROL_SAM_FREQ - 1);
 	if (writeable) {
 		data = cpu_to_le32(rate);
-		err = snd_usb_ctl_msg(dev, usb_sndctrlpipe(dev, 0), UAC2_CS_CUR,
-				      USB_TYPE_CLASS | USB_RECIP_INTERFACE | USB_DIR_OUT,
-				      UAC2_CS_CONTROL_SAM_FREQ << 8,
-				      snd_usb_ctrl_intf(chip) | (clock << 8),
-				      &data, sizeof(data));
+		err = snd_usb_ctl_msg_prio(chip, SND_USB_CTL_PRIO_STREAM,
+					   usb_sndctrlpipe(dev, 0), UAC2_CS_CUR,
+					   USB_TYPE_CLASS | USB_RECIP_INTERFACE | USB_DIR_OUT,
+					   UAC2_CS_CONTROL_SAM_FREQ << 8,
+					   snd_usb_ctrl_intf(chip) | (clock << 8),
+					   &data, sizeof(data));
 		if (err < 0) {
 			snd_printk(KERN_ERR "%d:%d:%d: cannot set freq %d (v2): err %d\n",
 				   dev->devnum, iface, fmt->altsetting, rate, err);
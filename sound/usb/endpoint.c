@@ -18,6 +18,7 @@
 #include <linux/gfp.h>
 #include <linux/init.h>
 #include <linux/ratelimit.h>
+#include <linux/sched.h>
 #include <linux/usb.h>
 #include <linux/usb/audio.h>
 #include <linux/slab.h>
@@ -37,6 +38,9 @@
 #define EP_FLAG_RUNNING		1
 #define EP_FLAG_STOPPING	2
 
+/* protects the aggregate_master/aggregate_slaves links of all endpoints */
+static DEFINE_SPINLOCK(aggregate_lock);
+
 /*
  * snd_usb_endpoint is a model that abstracts everything related to an
  * USB endpoint and its streaming.
@@ -62,6 +66,10 @@
  * can call snd_usb_endpoint_start() and snd_usb_endpoint_stop(), and
  * only the first user will effectively start the URBs, and only the last
  * one to stop it will tear the URBs down again.
+ *
+ * In aggregate mode, the feedback received by an endpoint of one card can
+ * also be forwarded to data endpoints of other cards on the same bus, see
+ * snd_usb_endpoint_link_aggregate().
  */
 
 /*
@@ -167,6 +175,72 @@ static void retire_outbound_urb(struct snd_usb_endpoint *ep,
 		ep->retire_data_urb(ep->data_subs, urb_ctx->urb);
 }
 
+/*
+ * switch a slave between the feedback of its aggregate master and its
+ * own; the two devices may use different feedback formats, so detect
+ * the format again.  call with aggregate_lock held
+ */
+static void set_aggregate_active(struct snd_usb_endpoint *ep, bool active)
+{
+	if (ep->aggregate_active != active)
+		ep->freqshift = INT_MIN;
+	ep->aggregate_active = active;
+}
+
+/*
+ * switch the slaves of an aggregate master between its feedback and
+ * their own, when the master is started or stopped
+ */
+static void set_aggregate_slaves_active(struct snd_usb_endpoint *ep,
+					bool active)
+{
+	struct snd_usb_endpoint *slave;
+	unsigned long flags;
+
+	spin_lock_irqsave(&aggregate_lock, flags);
+	list_for_each_entry(slave, &ep->aggregate_slaves, aggregate_list)
+		set_aggregate_active(slave, active &&
+				     slave->freqn == ep->freqn &&
+				     slave->datainterval == ep->datainterval);
+	spin_unlock_irqrestore(&aggregate_lock, flags);
+}
+
+/* detach a stopped slave from its foreign master */
+static void unlink_aggregate_master(struct snd_usb_endpoint *ep)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&aggregate_lock, flags);
+	if (ep->aggregate_master) {
+		list_del_init(&ep->aggregate_list);
+		ep->aggregate_master = NULL;
+		set_aggregate_active(ep, false);
+	}
+	spin_unlock_irqrestore(&aggregate_lock, flags);
+}
+
+/*
+ * forward a received feedback packet to the data endpoints of other
+ * cards that are slaved to this endpoint
+ */
+static void forward_aggregate_sync(struct snd_usb_endpoint *ep,
+				   const struct urb *urb)
+{
+	struct snd_usb_endpoint *slave;
+	unsigned long flags;
+
+	spin_lock_irqsave(&aggregate_lock, flags);
+	list_for_each_entry(slave, &ep->aggregate_slaves, aggregate_list) {
+		if (!slave->use_count || !slave->aggregate_active)
+			continue;
+		/* decode the feedback in the format detected by the master */
+		if (ep->sync_slave && ep->sync_slave->freqshift != INT_MIN)
+			slave->freqshift = ep->sync_slave->freqshift;
+		snd_usb_handle_sync_urb(slave, ep, urb);
+	}
+	spin_unlock_irqrestore(&aggregate_lock, flags);
+}
+
 static void retire_inbound_urb(struct snd_usb_endpoint *ep,
 			       struct snd_urb_ctx *urb_ctx)
 {
@@ -177,9 +251,13 @@ static void retire_inbound_urb(struct snd_usb_endpoint *ep,
 		return;
 	}
 
-	if (ep->sync_slave)
+	/* a slave of an aggregate ignores its own feedback */
+	if (ep->sync_slave && !ACCESS_ONCE(ep->sync_slave->aggregate_active))
 		snd_usb_handle_sync_urb(ep->sync_slave, ep, urb);
 
+	if (!list_empty(&ep->aggregate_slaves))
+		forward_aggregate_sync(ep, urb);
+
 	if (ep->retire_data_urb)
 		ep->retire_data_urb(ep->data_subs, urb);
 }
@@ -341,6 +419,25 @@ static void queue_pending_output_urbs(struct snd_usb_endpoint *ep)
 	}
 }
 
+/*
+ * account a completed urb in the endpoint statistics
+ */
+static void update_urb_stats(struct snd_usb_endpoint *ep,
+			     const struct urb *urb, u64 start)
+{
+	unsigned int i, ns;
+
+	ep->stat_urbs++;
+	for (i = 0; i < urb->number_of_packets; i++)
+		if (urb->iso_frame_desc[i].status)
+			ep->stat_packet_errors++;
+
+	ns = local_clock() - start;
+	ep->stat_complete_ns += ns;
+	if (ns > ep->stat_complete_max_ns)
+		ep->stat_complete_max_ns = ns;
+}
+
 /*
  * complete callback for urbs
  */
@@ -348,6 +445,7 @@ static void snd_complete_urb(struct urb *urb)
 {
 	struct snd_urb_ctx *ctx = urb->context;
 	struct snd_usb_endpoint *ep = ctx->ep;
+	u64 start = local_clock();
 	int err;
 
 	if (unlikely(urb->status == -ENOENT ||		/* unlinked */
@@ -370,6 +468,7 @@ static void snd_complete_urb(struct urb *urb)
 			list_add_tail(&ctx->ready_list, &ep->ready_playback_urbs);
 			spin_unlock_irqrestore(&ep->lock, flags);
 			queue_pending_output_urbs(ep);
+			update_urb_stats(ep, urb, start);
 
 			goto exit_clear;
 		}
@@ -385,9 +484,11 @@ static void snd_complete_urb(struct urb *urb)
 	}
 
 	err = usb_submit_urb(urb, GFP_ATOMIC);
+	update_urb_stats(ep, urb, start);
 	if (err == 0)
 		return;
 
+	ep->stat_submit_errors++;
 	snd_printk(KERN_ERR "cannot submit urb (err = %d)\n", err);
 	//snd_pcm_stop(substream, SNDRV_PCM_STATE_XRUN);
 
@@ -446,6 +547,8 @@ struct snd_usb_endpoint *snd_usb_add_endpoint(struct snd_usb_audio *chip,
 	ep->iface = alts->desc.bInterfaceNumber;
 	ep->alt_idx = alts->desc.bAlternateSetting;
 	INIT_LIST_HEAD(&ep->ready_playback_urbs);
+	INIT_LIST_HEAD(&ep->aggregate_slaves);
+	INIT_LIST_HEAD(&ep->aggregate_list);
 	ep_num &= USB_ENDPOINT_NUMBER_MASK;
 
 	if (is_playback)
@@ -842,6 +945,16 @@ int snd_usb_endpoint_start(struct snd_usb_endpoint *ep, bool can_sleep)
 	ep->unlink_mask = 0;
 	ep->phase = 0;
 
+	/* a restarted aggregate master takes over its slaves again */
+	set_aggregate_slaves_active(ep, true);
+
+	ep->stat_start = jiffies;
+	ep->stat_urbs = 0;
+	ep->stat_packet_errors = 0;
+	ep->stat_submit_errors = 0;
+	ep->stat_complete_ns = 0;
+	ep->stat_complete_max_ns = 0;
+
 	snd_usb_endpoint_start_quirk(ep);
 
 	/*
@@ -915,6 +1028,9 @@ void snd_usb_endpoint_stop(struct snd_usb_endpoint *ep)
 		return;
 
 	if (--ep->use_count == 0) {
+		/* our slaves stay linked and fall back to their own feedback */
+		set_aggregate_slaves_active(ep, false);
+		unlink_aggregate_master(ep);
 		deactivate_urbs(ep, false);
 		ep->data_subs = NULL;
 		ep->sync_slave = NULL;
@@ -966,10 +1082,102 @@ void snd_usb_endpoint_free(struct list_head *head)
 	struct snd_usb_endpoint *ep;
 
 	ep = list_entry(head, struct snd_usb_endpoint, list);
+	snd_usb_endpoint_unlink_aggregate(ep);
 	release_urbs(ep, 1);
 	kfree(ep);
 }
 
+/**
+ * snd_usb_endpoint_link_aggregate: slave a data endpoint to a foreign master
+ *
+ * @ep: the playback data endpoint to be slaved
+ * @master: the sync endpoint of another card providing the feedback
+ *
+ * After this call, the feedback received by @master is used to size the
+ * packets of @ep, and the feedback of @ep's own sync endpoint is ignored.
+ * Both endpoints must have been configured for the same rate, and their
+ * devices must share the same bus, so that they share one frame clock.
+ *
+ * The link is kept until either endpoint is freed or @ep is stopped; while
+ * @master is stopped, @ep uses the feedback of its own sync endpoint.
+ * The caller must keep @master from being freed, see
+ * snd_usb_link_aggregate_master().
+ *
+ * Returns 0 on success, -ENODEV if @master isn't running, or another
+ * negative error code.
+ */
+int snd_usb_endpoint_link_aggregate(struct snd_usb_endpoint *ep,
+				    struct snd_usb_endpoint *master)
+{
+	unsigned long flags;
+
+	if (ep->chip == master->chip ||
+	    ep->type != SND_USB_ENDPOINT_TYPE_DATA || !usb_pipeout(ep->pipe) ||
+	    master->type != SND_USB_ENDPOINT_TYPE_SYNC ||
+	    snd_usb_endpoint_implicit_feedback_sink(ep))
+		return -EINVAL;
+
+	if (ep->chip->dev->bus != master->chip->dev->bus ||
+	    snd_usb_get_speed(ep->chip->dev) !=
+	    snd_usb_get_speed(master->chip->dev))
+		return -EXDEV;
+
+	if (ep->freqn != master->freqn ||
+	    ep->datainterval != master->datainterval)
+		return -EINVAL;
+
+	spin_lock_irqsave(&aggregate_lock, flags);
+	/* the master may have been stopped since it was looked up */
+	if (!master->use_count) {
+		spin_unlock_irqrestore(&aggregate_lock, flags);
+		return -ENODEV;
+	}
+	if (ep->aggregate_master) {
+		list_del(&ep->aggregate_list);
+		set_aggregate_active(ep, false);
+	}
+	ep->aggregate_master = master;
+	set_aggregate_active(ep, true);
+	list_add_tail(&ep->aggregate_list, &master->aggregate_slaves);
+	spin_unlock_irqrestore(&aggregate_lock, flags);
+
+	snd_printdd(KERN_DEBUG "EP #%x @%p slaved to EP #%x @%p\n",
+		    ep->ep_num, ep, master->ep_num, master);
+
+	return 0;
+}
+
+/**
+ * snd_usb_endpoint_unlink_aggregate: detach an endpoint from its aggregate
+ *
+ * @ep: the endpoint to detach (may be NULL)
+ *
+ * Detaches @ep from its foreign master, if any, and detaches all
+ * endpoints that are slaved to @ep.
+ */
+void snd_usb_endpoint_unlink_aggregate(struct snd_usb_endpoint *ep)
+{
+	struct snd_usb_endpoint *slave, *next;
+	unsigned long flags;
+
+	if (!ep)
+		return;
+
+	spin_lock_irqsave(&aggregate_lock, flags);
+	if (ep->aggregate_master) {
+		list_del_init(&ep->aggregate_list);
+		ep->aggregate_master = NULL;
+		set_aggregate_active(ep, false);
+	}
+	list_for_each_entry_safe(slave, next, &ep->aggregate_slaves,
+				 aggregate_list) {
+		list_del_init(&slave->aggregate_list);
+		slave->aggregate_master = NULL;
+		set_aggregate_active(slave, false);
+	}
+	spin_unlock_irqrestore(&aggregate_lock, flags);
+}
+
 /**
  * snd_usb_handle_sync_urb: parse an USB sync packet
  *
@@ -26,6 +26,12 @@ void snd_usb_endpoint_free(struct list_head *head);
 int snd_usb_endpoint_implicit_feedback_sink(struct snd_usb_endpoint *ep);
 int snd_usb_endpoint_next_packet_size(struct snd_usb_endpoint *ep);
 
+int  snd_usb_endpoint_link_aggregate(struct snd_usb_endpoint *ep,
+				     struct snd_usb_endpoint *master);
+void snd_usb_endpoint_unlink_aggregate(struct snd_usb_endpoint *ep);
+int snd_usb_link_aggregate_master(struct snd_usb_audio *chip,
+				  struct snd_usb_endpoint *ep);
+
 void snd_usb_handle_sync_urb(struct snd_usb_endpoint *ep,
 			     struct snd_usb_endpoint *sender,
 			     const struct urb *urb);
@@ -16,8 +16,10 @@
  */
 
 #include <linux/init.h>
+#include <linux/sched.h>
 #include <linux/slab.h>
 #include <linux/usb.h>
+#include <linux/wait.h>
 
 #include "usbaudio.h"
 #include "helper.h"
@@ -113,6 +115,121 @@ int snd_usb_ctl_msg(struct usb_device *dev, unsigned int pipe, __u8 request,
 	return err;
 }
 
+/*
+ * Control request scheduling
+ *
+ * All requests issued through snd_usb_ctl_msg_prio() are serialized per
+ * chip.  A request may only start when no request of a higher priority
+ * class is waiting, so that stream setup isn't stuck behind a flood of
+ * mixer reads.  Meter polls are additionally rate limited to one per
+ * ctl_poll_interval ms (except while probing).  Callers may hold
+ * shutdown_rwsem, so all waits bail out on a disconnect.
+ */
+
+/* returns 1 if entered, 0 to keep waiting, or -ENODEV on a disconnect */
+static int ctl_sched_try_enter(struct snd_usb_audio *chip, int prio)
+{
+	unsigned long flags;
+	int ret;
+	int i;
+
+	spin_lock_irqsave(&chip->ctl_lock, flags);
+	if (chip->ctl_shutdown) {
+		chip->ctl_pending[prio]--;
+		ret = -ENODEV;
+	} else {
+		ret = !chip->ctl_busy;
+		for (i = 0; ret && i < prio; i++)
+			if (chip->ctl_pending[i])
+				ret = 0;
+		if (ret) {
+			chip->ctl_busy = true;
+			chip->ctl_pending[prio]--;
+		}
+	}
+	spin_unlock_irqrestore(&chip->ctl_lock, flags);
+
+	return ret;
+}
+
+static int ctl_sched_poll_delay(struct snd_usb_audio *chip)
+{
+	unsigned long now, wait = 0;
+	long ret;
+
+	spin_lock_irq(&chip->ctl_lock);
+	now = jiffies;
+	if (time_before(now, chip->ctl_next_poll)) {
+		wait = chip->ctl_next_poll - now;
+		now = chip->ctl_next_poll;
+	}
+	chip->ctl_next_poll = now + msecs_to_jiffies(chip->ctl_poll_interval);
+	spin_unlock_irq(&chip->ctl_lock);
+
+	if (!wait)
+		return 0;
+	ret = wait_event_interruptible_timeout(chip->ctl_wait,
+					       chip->ctl_shutdown, wait);
+	if (ret < 0)
+		return ret;
+	return chip->ctl_shutdown ? -ENODEV : 0;
+}
+
+/*
+ * Scheduled variant of snd_usb_ctl_msg(); @prio is one of
+ * SND_USB_CTL_PRIO_*.  Must be called from a sleepable context.
+ */
+int snd_usb_ctl_msg_prio(struct snd_usb_audio *chip, int prio,
+			 unsigned int pipe, __u8 request, __u8 requesttype,
+			 __u16 value, __u16 index, void *data, __u16 size)
+{
+	struct snd_usb_ctl_stats *stats = &chip->ctl_stats[prio];
+	u64 start, ns;
+	int entered = 0;
+	int err;
+
+	start = local_clock();
+
+	if (prio == SND_USB_CTL_PRIO_POLL && chip->ctl_poll_interval &&
+	    !chip->probing) {
+		err = ctl_sched_poll_delay(chip);
+		if (err < 0)
+			return err;
+	}
+
+	spin_lock_irq(&chip->ctl_lock);
+	chip->ctl_pending[prio]++;
+	spin_unlock_irq(&chip->ctl_lock);
+
+	err = wait_event_killable(chip->ctl_wait,
+		(entered = ctl_sched_try_enter(chip, prio)) != 0);
+	if (err < 0) {
+		spin_lock_irq(&chip->ctl_lock);
+		chip->ctl_pending[prio]--;
+		spin_unlock_irq(&chip->ctl_lock);
+		/* lower classes may be able to enter now */
+		wake_up_all(&chip->ctl_wait);
+		return err;
+	}
+	if (entered < 0)
+		return entered;
+
+	err = snd_usb_ctl_msg(chip->dev, pipe, request, requesttype,
+			      value, index, data, size);
+
+	ns = local_clock() - start;
+	spin_lock_irq(&chip->ctl_lock);
+	chip->ctl_busy = false;
+	stats->count++;
+	stats->total_ns += ns;
+	if (ns > stats->max_ns)
+		stats->max_ns = ns;
+	spin_unlock_irq(&chip->ctl_lock);
+	wake_up_all(&chip->ctl_wait);
+
+	return err;
+}
+
 unsigned char snd_usb_parse_datainterval(struct snd_usb_audio *chip,
 					 struct usb_host_interface *alts)
 {
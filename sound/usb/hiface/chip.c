@@ -46,6 +46,7 @@ MODULE_SUPPORTED_DEVICE("{{M2Tech,Young},"
 static int index[SNDRV_CARDS] = SNDRV_DEFAULT_IDX; /* Index 0-max */
 static char *id[SNDRV_CARDS] = SNDRV_DEFAULT_STR; /* Id for card */
 static bool enable[SNDRV_CARDS] = SNDRV_DEFAULT_ENABLE_PNP; /* Enable this card */
+static bool prefill[SNDRV_CARDS]; /* Keep playback urbs filled ahead */
 
 #define DRIVER_NAME "snd-usb-hiface"
 #define CARD_NAME "hiFace"
@@ -56,6 +57,8 @@ module_param_array(id, charp, NULL, 0444);
 MODULE_PARM_DESC(id, "ID string for " CARD_NAME " soundcard.");
 module_param_array(enable, bool, NULL, 0444);
 MODULE_PARM_DESC(enable, "Enable " CARD_NAME " soundcard.");
+module_param_array(prefill, bool, NULL, 0444);
+MODULE_PARM_DESC(prefill, "Keep one period of playback URBs filled ahead for " CARD_NAME " soundcard.");
 
 static DEFINE_MUTEX(register_mutex);
 
@@ -138,7 +141,7 @@ static int hiface_chip_probe(struct usb_interface *intf,
 
 	snd_card_set_dev(chip->card, &intf->dev);
 
-	ret = hiface_pcm_init(chip, quirk ? quirk->extra_freq : 0);
+	ret = hiface_pcm_init(chip, quirk ? quirk->extra_freq : 0, prefill[i]);
 	if (ret < 0)
 		goto err_chip_destroy;
 
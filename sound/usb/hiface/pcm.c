@@ -15,7 +15,10 @@
  */
 
 #include <linux/slab.h>
+#include <linux/sched.h>
+#include <linux/math64.h>
 #include <sound/pcm.h>
+#include <sound/info.h>
 
 #include "pcm.h"
 #include "chip.h"
@@ -24,6 +27,7 @@
 #define PCM_N_URBS      8
 #define PCM_PACKET_SIZE 4096
 #define PCM_BUFFER_SIZE (2 * PCM_N_URBS * PCM_PACKET_SIZE)
+#define PCM_N_PREFILL   8 /* max. urbs kept filled ahead in prefill mode */
 
 struct pcm_urb {
 	struct hiface_chip *chip;
@@ -31,6 +35,7 @@ struct pcm_urb {
 	struct urb instance;
 	struct usb_anchor submitted;
 	u8 *buffer;
+	bool has_data; /* prefilled with stream data, not yet submitted */
 };
 
 struct pcm_substream {
@@ -56,13 +61,32 @@ struct pcm_runtime {
 	struct pcm_substream playback;
 	bool panic; /* if set driver won't do anymore pcm on device */
 
-	struct pcm_urb out_urbs[PCM_N_URBS];
+	struct pcm_urb out_urbs[PCM_N_URBS + PCM_N_PREFILL];
 
 	struct mutex stream_mutex;
 	u8 stream_state; /* one of STREAM_XXX */
 	u8 extra_freq;
 	wait_queue_head_t stream_wait_queue;
 	bool stream_wait_cond;
+
+	/*
+	 * prefill mode: a ring of n_prefill urbs filled ahead of time; when
+	 * an urb completes, the oldest ready urb is submitted right away and
+	 * the completed one is refilled and takes its place in the ring
+	 */
+	bool prefill;
+	unsigned int n_prefill;
+	unsigned int ready_head;
+	struct pcm_urb *ready[PCM_N_PREFILL];
+	unsigned int prefill_bytes; /* stream data held in the ring */
+
+	/* deadline tracking, protected by playback.lock */
+	atomic_t urbs_queued;	/* urbs currently owned by the host controller */
+	u32 urb_ns;		/* playing time of one urb */
+	unsigned int slack_count;
+	unsigned int slack_late; /* resubmitted after the queue ran dry */
+	s64 slack_min_ns;
+	s64 slack_sum_ns;
 };
 
 static const unsigned int rates[] = { 44100, 48000, 88200, 96000, 176400, 192000,
@@ -193,7 +217,7 @@ static void hiface_pcm_stream_stop(struct pcm_runtime *rt)
 	if (rt->stream_state != STREAM_DISABLED) {
 		rt->stream_state = STREAM_STOPPING;
 
-		for (i = 0; i < PCM_N_URBS; i++) {
+		for (i = 0; i < PCM_N_URBS + PCM_N_PREFILL; i++) {
 			time = usb_wait_anchor_empty_timeout(
 					&rt->out_urbs[i].submitted, 100);
 			if (!time)
@@ -217,15 +241,32 @@ static int hiface_pcm_stream_start(struct pcm_runtime *rt)
 		/* reset panic state when starting a new stream */
 		rt->panic = false;
 
+		/* the prefill ring starts out with silence */
+		rt->ready_head = 0;
+		for (i = 0; i < rt->n_prefill; i++) {
+			rt->ready[i] = &rt->out_urbs[PCM_N_URBS + i];
+			memset(rt->ready[i]->buffer, 0, PCM_PACKET_SIZE);
+			rt->ready[i]->has_data = false;
+		}
+		rt->prefill_bytes = 0;
+
+		rt->slack_count = 0;
+		rt->slack_late = 0;
+		rt->slack_min_ns = S64_MAX;
+		rt->slack_sum_ns = 0;
+		atomic_set(&rt->urbs_queued, 0);
+
 		/* submit our out urbs zero init */
 		rt->stream_state = STREAM_STARTING;
 		for (i = 0; i < PCM_N_URBS; i++) {
 			memset(rt->out_urbs[i].buffer, 0, PCM_PACKET_SIZE);
 			usb_anchor_urb(&rt->out_urbs[i].instance,
 				       &rt->out_urbs[i].submitted);
+			atomic_inc(&rt->urbs_queued);
 			ret = usb_submit_urb(&rt->out_urbs[i].instance,
 					     GFP_ATOMIC);
 			if (ret) {
+				atomic_dec(&rt->urbs_queued);
 				hiface_pcm_stream_stop(rt);
 				return ret;
 			}
@@ -305,15 +346,51 @@ static bool hiface_pcm_playback(struct pcm_substream *sub, struct pcm_urb *urb)
 	return false;
 }
 
+/* call with substream locked */
+static void hiface_pcm_fill_urb(struct pcm_substream *sub, struct pcm_urb *urb,
+				bool *do_period_elapsed)
+{
+	if (sub->active)
+		*do_period_elapsed |= hiface_pcm_playback(sub, urb);
+	else
+		memset(urb->buffer, 0, PCM_PACKET_SIZE);
+}
+
+/*
+ * call with substream locked
+ *
+ * At completion time the urbs still queued hold queued * urb_ns of audio;
+ * that is the deadline for handing the next urb to the host controller.
+ */
+static void hiface_pcm_update_slack(struct pcm_runtime *rt,
+				    unsigned int queued, u64 completed_ns)
+{
+	s64 slack;
+
+	slack = (s64)queued * rt->urb_ns - (s64)(local_clock() - completed_ns);
+	if (slack < 0)
+		rt->slack_late++;
+	if (slack < rt->slack_min_ns)
+		rt->slack_min_ns = slack;
+	rt->slack_sum_ns += slack;
+	rt->slack_count++;
+}
+
 static void hiface_pcm_out_urb_handler(struct urb *usb_urb)
 {
 	struct pcm_urb *out_urb = usb_urb->context;
 	struct pcm_runtime *rt = out_urb->chip->pcm;
 	struct pcm_substream *sub;
+	struct pcm_urb *next_urb;
 	bool do_period_elapsed = false;
+	unsigned int queued;
 	unsigned long flags;
+	u64 completed_ns;
 	int ret;
 
+	completed_ns = local_clock();
+	queued = atomic_dec_return(&rt->urbs_queued);
+
 	if (rt->panic || rt->stream_state == STREAM_STOPPING)
 		return;
 
@@ -329,23 +406,46 @@ static void hiface_pcm_out_urb_handler(struct urb *usb_urb)
 		wake_up(&rt->stream_wait_queue);
 	}
 
-	/* now send our playback data (if a free out urb was found) */
 	sub = &rt->playback;
 	spin_lock_irqsave(&sub->lock, flags);
-	if (sub->active)
-		do_period_elapsed = hiface_pcm_playback(sub, out_urb);
-	else
-		memset(out_urb->buffer, 0, PCM_PACKET_SIZE);
+	if (rt->n_prefill) {
+		/* submit the oldest ready urb first, then refill this one */
+		next_urb = rt->ready[rt->ready_head];
+		rt->ready[rt->ready_head] = out_urb;
+		rt->ready_head = (rt->ready_head + 1) % rt->n_prefill;
+		if (next_urb->has_data) {
+			next_urb->has_data = false;
+			rt->prefill_bytes -= PCM_PACKET_SIZE;
+		}
+	} else {
+		/* now send our playback data (if a free out urb was found) */
+		next_urb = out_urb;
+		hiface_pcm_fill_urb(sub, out_urb, &do_period_elapsed);
+	}
+
+	/* keep it anchored so that hiface_pcm_stream_stop() can wait for it */
+	usb_anchor_urb(&next_urb->instance, &next_urb->submitted);
+	atomic_inc(&rt->urbs_queued);
+	ret = usb_submit_urb(&next_urb->instance, GFP_ATOMIC);
+	if (ret < 0) {
+		atomic_dec(&rt->urbs_queued);
+		usb_unanchor_urb(&next_urb->instance);
+		spin_unlock_irqrestore(&sub->lock, flags);
+		goto out_fail;
+	}
+	hiface_pcm_update_slack(rt, queued, completed_ns);
 
+	if (rt->n_prefill) {
+		hiface_pcm_fill_urb(sub, out_urb, &do_period_elapsed);
+		out_urb->has_data = sub->active;
+		if (out_urb->has_data)
+			rt->prefill_bytes += PCM_PACKET_SIZE;
+	}
 	spin_unlock_irqrestore(&sub->lock, flags);
 
 	if (do_period_elapsed)
 		snd_pcm_period_elapsed(sub->instance);
 
-	ret = usb_submit_urb(&out_urb->instance, GFP_ATOMIC);
-	if (ret < 0)
-		goto out_fail;
-
 	return;
 
 out_fail:
@@ -450,6 +550,15 @@ static int hiface_pcm_prepare(struct snd_pcm_substream *alsa_sub)
 
 	if (rt->stream_state == STREAM_DISABLED) {
 
+		rt->urb_ns = div_u64((u64)PCM_PACKET_SIZE * NSEC_PER_SEC,
+				     frames_to_bytes(alsa_rt, alsa_rt->rate));
+		/* keep about one period of urbs ready */
+		rt->n_prefill = 0;
+		if (rt->prefill)
+			rt->n_prefill = clamp_t(unsigned int,
+				snd_pcm_lib_period_bytes(alsa_sub) / PCM_PACKET_SIZE,
+				1, PCM_N_PREFILL);
+
 		ret = hiface_pcm_set_rate(rt, alsa_rt->rate);
 		if (ret) {
 			mutex_unlock(&rt->stream_mutex);
@@ -469,6 +578,7 @@ static int hiface_pcm_trigger(struct snd_pcm_substream *alsa_sub, int cmd)
 {
 	struct pcm_substream *sub = hiface_pcm_get_substream(alsa_sub);
 	struct pcm_runtime *rt = snd_pcm_substream_chip(alsa_sub);
+	int i;
 
 	if (rt->panic)
 		return -EPIPE;
@@ -487,6 +597,12 @@ static int hiface_pcm_trigger(struct snd_pcm_substream *alsa_sub, int cmd)
 	case SNDRV_PCM_TRIGGER_PAUSE_PUSH:
 		spin_lock_irq(&sub->lock);
 		sub->active = false;
+		/* don't replay stale prefilled data on the next start */
+		for (i = 0; i < rt->n_prefill; i++) {
+			memset(rt->ready[i]->buffer, 0, PCM_PACKET_SIZE);
+			rt->ready[i]->has_data = false;
+		}
+		rt->prefill_bytes = 0;
 		spin_unlock_irq(&sub->lock);
 		return 0;
 
@@ -507,6 +623,9 @@ static snd_pcm_uframes_t hiface_pcm_pointer(struct snd_pcm_substream *alsa_sub)
 
 	spin_lock_irqsave(&sub->lock, flags);
 	dma_offset = sub->dma_off;
+	/* the position runs ahead by the data waiting in the prefill ring */
+	alsa_sub->runtime->delay = bytes_to_frames(alsa_sub->runtime,
+						   rt->prefill_bytes);
 	spin_unlock_irqrestore(&sub->lock, flags);
 	return bytes_to_frames(alsa_sub->runtime, dma_offset);
 }
@@ -544,6 +663,33 @@ static int hiface_pcm_init_urb(struct pcm_urb *urb,
 	return 0;
 }
 
+static void hiface_pcm_proc_read(struct snd_info_entry *entry,
+				 struct snd_info_buffer *buffer)
+{
+	struct pcm_runtime *rt = entry->private_data;
+	unsigned int count, late;
+	s64 min_ns, sum_ns;
+
+	spin_lock_irq(&rt->playback.lock);
+	count = rt->slack_count;
+	late = rt->slack_late;
+	min_ns = rt->slack_min_ns;
+	sum_ns = rt->slack_sum_ns;
+	spin_unlock_irq(&rt->playback.lock);
+
+	snd_iprintf(buffer, "Prefilled URBs: %u\n", rt->n_prefill);
+	snd_iprintf(buffer, "URBs in flight: %d\n",
+		    atomic_read(&rt->urbs_queued));
+	snd_iprintf(buffer, "URB duration: %u us\n", rt->urb_ns / 1000);
+	snd_iprintf(buffer, "Completions: %u\n", count);
+	if (!count)
+		return;
+	snd_iprintf(buffer, "Slack: min %lld us, avg %lld us\n",
+		    div_s64(min_ns, 1000),
+		    div_s64(div_s64(sum_ns, count), 1000));
+	snd_iprintf(buffer, "Missed deadlines: %u\n", late);
+}
+
 void hiface_pcm_abort(struct hiface_chip *chip)
 {
 	struct pcm_runtime *rt = chip->pcm;
@@ -562,7 +708,7 @@ static void hiface_pcm_destroy(struct hiface_chip *chip)
 	struct pcm_runtime *rt = chip->pcm;
 	int i;
 
-	for (i = 0; i < PCM_N_URBS; i++)
+	for (i = 0; i < PCM_N_URBS + PCM_N_PREFILL; i++)
 		kfree(rt->out_urbs[i].buffer);
 
 	kfree(chip->pcm);
@@ -577,12 +723,13 @@ static void hiface_pcm_free(struct snd_pcm *pcm)
 		hiface_pcm_destroy(rt->chip);
 }
 
-int hiface_pcm_init(struct hiface_chip *chip, u8 extra_freq)
+int hiface_pcm_init(struct hiface_chip *chip, u8 extra_freq, bool prefill)
 {
 	int i;
 	int ret;
 	struct snd_pcm *pcm;
 	struct pcm_runtime *rt;
+	struct snd_info_entry *entry;
 
 	rt = kzalloc(sizeof(*rt), GFP_KERNEL);
 	if (!rt)
@@ -592,12 +739,13 @@ int hiface_pcm_init(struct hiface_chip *chip, u8 extra_freq)
 	rt->stream_state = STREAM_DISABLED;
 	if (extra_freq)
 		rt->extra_freq = 1;
+	rt->prefill = prefill;
 
 	init_waitqueue_head(&rt->stream_wait_queue);
 	mutex_init(&rt->stream_mutex);
 	spin_lock_init(&rt->playback.lock);
 
-	for (i = 0; i < PCM_N_URBS; i++)
+	for (i = 0; i < PCM_N_URBS + PCM_N_PREFILL; i++)
 		hiface_pcm_init_urb(&rt->out_urbs[i], chip, OUT_EP,
 				    hiface_pcm_out_urb_handler);
 
@@ -616,6 +764,9 @@ int hiface_pcm_init(struct hiface_chip *chip, u8 extra_freq)
 
 	rt->instance = pcm;
 
+	if (!snd_card_proc_new(chip->card, "pcm_stats", &entry))
+		snd_info_set_text_ops(entry, rt, hiface_pcm_proc_read);
+
 	chip->pcm = rt;
 	return 0;
 }
@@ -19,6 +19,6 @@
 
 struct hiface_chip;
 
-int hiface_pcm_init(struct hiface_chip *chip, u8 extra_freq);
+int hiface_pcm_init(struct hiface_chip *chip, u8 extra_freq, bool prefill);
 void hiface_pcm_abort(struct hiface_chip *chip);
 #endif /* HIFACE_PCM_H */
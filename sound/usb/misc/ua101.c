@@ -106,6 +106,8 @@ struct ua101 {
 	u8 rate_feedback[MAX_QUEUE_LENGTH];
 
 	struct list_head ready_playback_urbs;
+	unsigned int ready_playback_count;
+	unsigned int playback_batch;
 	struct tasklet_struct playback_tasklet;
 	wait_queue_head_t alsa_capture_wait;
 	wait_queue_head_t rate_feedback_wait;
@@ -130,6 +132,9 @@ struct ua101 {
 			dma_addr_t dma;
 		} buffers[MAX_MEMORY_BUFFERS];
 	} capture, playback;
+
+	/* the batch being submitted by the playback tasklet */
+	struct ua101_urb *playback_urbs[MAX_QUEUE_LENGTH];
 };
 
 static DEFINE_MUTEX(devices_mutex);
@@ -178,6 +183,28 @@ static void abort_usb_playback(struct ua101 *ua)
 		wake_up(&ua->alsa_playback_wait);
 }
 
+/*
+ * The playback tasklet is scheduled only when a whole batch of packets can
+ * be submitted.  The batch is half a period, so that the tasklet runs about
+ * twice per period regardless of the queue length, but at most half of the
+ * queue, so that the number of queued URBs never drops below the host
+ * controller's scheduling delay.
+ */
+static unsigned int playback_batch_size(struct ua101 *ua,
+					snd_pcm_uframes_t period_size)
+{
+	unsigned int packets;
+
+	packets = DIV_ROUND_UP(period_size * ua->packets_per_second, ua->rate);
+	return clamp(packets / 2, 1u, ua->playback.queue_length / 2);
+}
+
+static inline bool playback_batch_ready(struct ua101 *ua)
+{
+	return ua->rate_feedback_count >= ua->playback_batch &&
+		ua->ready_playback_count >= ua->playback_batch;
+}
+
 static void playback_urb_complete(struct urb *usb_urb)
 {
 	struct ua101_urb *urb = (struct ua101_urb *)usb_urb;
@@ -197,7 +224,8 @@ static void playback_urb_complete(struct urb *usb_urb)
 		/* append URB to FIFO */
 		spin_lock_irqsave(&ua->lock, flags);
 		list_add_tail(&urb->ready_list, &ua->ready_playback_urbs);
-		if (ua->rate_feedback_count > 0)
+		ua->ready_playback_count++;
+		if (playback_batch_ready(ua))
 			tasklet_schedule(&ua->playback_tasklet);
 		ua->playback.substream->runtime->delay -=
 				urb->urb.iso_frame_desc[0].length /
@@ -217,33 +245,48 @@ static void first_playback_urb_complete(struct urb *urb)
 	wake_up(&ua->alsa_playback_wait);
 }
 
-/* copy data from the ALSA ring buffer into the URB buffer */
-static bool copy_playback_data(struct ua101_stream *stream, struct urb *urb,
-			       unsigned int frames)
+/*
+ * copy data from the ALSA ring buffer into a batch of URB buffers;
+ * the packet lengths must already have been set
+ */
+static bool copy_playback_data(struct ua101_stream *stream,
+			       struct ua101_urb **urbs, unsigned int count)
 {
 	struct snd_pcm_runtime *runtime;
-	unsigned int frame_bytes, frames1;
+	unsigned int frame_bytes, bytes, bytes1, wrap_bytes, total_bytes, i;
 	const u8 *source;
 
 	runtime = stream->substream->runtime;
 	frame_bytes = stream->frame_bytes;
 	source = runtime->dma_area + stream->buffer_pos * frame_bytes;
-	if (stream->buffer_pos + frames <= runtime->buffer_size) {
-		memcpy(urb->transfer_buffer, source, frames * frame_bytes);
-	} else {
-		/* wrap around at end of ring buffer */
-		frames1 = runtime->buffer_size - stream->buffer_pos;
-		memcpy(urb->transfer_buffer, source, frames1 * frame_bytes);
-		memcpy(urb->transfer_buffer + frames1 * frame_bytes,
-		       runtime->dma_area, (frames - frames1) * frame_bytes);
+	/* the distance to the end of the ring buffer is computed only once */
+	wrap_bytes = (runtime->buffer_size - stream->buffer_pos) * frame_bytes;
+	total_bytes = 0;
+
+	for (i = 0; i < count; ++i) {
+		u8 *dest = urbs[i]->urb.transfer_buffer;
+
+		bytes = urbs[i]->urb.iso_frame_desc[0].length;
+		total_bytes += bytes;
+		if (likely(bytes < wrap_bytes)) {
+			memcpy(dest, source, bytes);
+			source += bytes;
+			wrap_bytes -= bytes;
+		} else {
+			/* wrap around at end of ring buffer */
+			bytes1 = wrap_bytes;
+			memcpy(dest, source, bytes1);
+			memcpy(dest + bytes1, runtime->dma_area, bytes - bytes1);
+			source = runtime->dma_area + (bytes - bytes1);
+			wrap_bytes = runtime->buffer_size * frame_bytes -
+				(bytes - bytes1);
+		}
 	}
 
-	stream->buffer_pos += frames;
-	if (stream->buffer_pos >= runtime->buffer_size)
-		stream->buffer_pos -= runtime->buffer_size;
-	stream->period_pos += frames;
+	stream->buffer_pos = (source - runtime->dma_area) / frame_bytes;
+	stream->period_pos += total_bytes / frame_bytes;
 	if (stream->period_pos >= runtime->period_size) {
-		stream->period_pos -= runtime->period_size;
+		stream->period_pos %= runtime->period_size;
 		return true;
 	}
 	return false;
@@ -261,8 +304,8 @@ static void playback_tasklet(unsigned long data)
 {
 	struct ua101 *ua = (void *)data;
 	unsigned long flags;
-	unsigned int frames;
-	struct ua101_urb *urb;
+	unsigned int frames, count, i;
+	struct ua101_urb **urbs = ua->playback_urbs;
 	bool do_period_elapsed = false;
 	int err;
 
@@ -279,8 +322,12 @@ static void playback_tasklet(unsigned long data)
 	 * called alternately, we use two FIFOs for packet sizes and read URBs;
 	 * submitting playback URBs is possible as long as both FIFOs are
 	 * nonempty.
+	 *
+	 * All packets that can be submitted are handled as one batch, so that
+	 * the ring buffer position is updated only once.
 	 */
 	spin_lock_irqsave(&ua->lock, flags);
+	count = 0;
 	while (ua->rate_feedback_count > 0 &&
 	       !list_empty(&ua->ready_playback_urbs)) {
 		/* take packet size out of FIFO */
@@ -289,23 +336,28 @@ static void playback_tasklet(unsigned long data)
 		ua->rate_feedback_count--;
 
 		/* take URB out of FIFO */
-		urb = list_first_entry(&ua->ready_playback_urbs,
-				       struct ua101_urb, ready_list);
-		list_del(&urb->ready_list);
+		urbs[count] = list_first_entry(&ua->ready_playback_urbs,
+					       struct ua101_urb, ready_list);
+		list_del(&urbs[count]->ready_list);
+		ua->ready_playback_count--;
 
-		/* fill packet with data or silence */
-		urb->urb.iso_frame_desc[0].length =
+		urbs[count]->urb.iso_frame_desc[0].length =
 			frames * ua->playback.frame_bytes;
-		if (test_bit(ALSA_PLAYBACK_RUNNING, &ua->states))
-			do_period_elapsed |= copy_playback_data(&ua->playback,
-								&urb->urb,
-								frames);
-		else
-			memset(urb->urb.transfer_buffer, 0,
-			       urb->urb.iso_frame_desc[0].length);
-
-		/* and off you go ... */
-		err = usb_submit_urb(&urb->urb, GFP_ATOMIC);
+		count++;
+	}
+
+	/* fill packets with data or silence */
+	if (test_bit(ALSA_PLAYBACK_RUNNING, &ua->states))
+		do_period_elapsed = copy_playback_data(&ua->playback,
+						       urbs, count);
+	else
+		for (i = 0; i < count; ++i)
+			memset(urbs[i]->urb.transfer_buffer, 0,
+			       urbs[i]->urb.iso_frame_desc[0].length);
+
+	/* and off you go ... */
+	for (i = 0; i < count; ++i) {
+		err = usb_submit_urb(&urbs[i]->urb, GFP_ATOMIC);
 		if (unlikely(err < 0)) {
 			spin_unlock_irqrestore(&ua->lock, flags);
 			abort_usb_playback(ua);
@@ -314,7 +366,9 @@ static void playback_tasklet(unsigned long data)
 				err, usb_error_string(err));
 			return;
 		}
-		ua->playback.substream->runtime->delay += frames;
+		ua->playback.substream->runtime->delay +=
+			urbs[i]->urb.iso_frame_desc[0].length /
+						ua->playback.frame_bytes;
 	}
 	spin_unlock_irqrestore(&ua->lock, flags);
 	if (do_period_elapsed)
@@ -410,7 +464,7 @@ static void capture_urb_complete(struct urb *urb)
 			add_with_wraparound(ua, &ua->rate_feedback_start, 1);
 		}
 		if (test_bit(USB_PLAYBACK_RUNNING, &ua->states) &&
-		    !list_empty(&ua->ready_playback_urbs))
+		    playback_batch_ready(ua))
 			tasklet_schedule(&ua->playback_tasklet);
 	}
 
@@ -571,6 +625,13 @@ static int start_usb_playback(struct ua101 *ua)
 		first_playback_urb_complete;
 	spin_lock_irq(&ua->lock);
 	INIT_LIST_HEAD(&ua->ready_playback_urbs);
+	ua->ready_playback_count = 0;
+	/*
+	 * when called from open, the period size is still zero and this
+	 * gives batches of one URB until hw_params sets the real size
+	 */
+	ua->playback_batch = playback_batch_size(ua,
+			ua->playback.substream->runtime->period_size);
 	spin_unlock_irq(&ua->lock);
 
 	/*
@@ -761,6 +822,11 @@ static int playback_pcm_hw_params(struct snd_pcm_substream *substream,
 	if (err < 0)
 		return err;
 
+	spin_lock_irq(&ua->lock);
+	ua->playback_batch = playback_batch_size(ua,
+					params_period_size(hw_params));
+	spin_unlock_irq(&ua->lock);
+
 	return snd_pcm_lib_alloc_vmalloc_buffer(substream,
 						params_buffer_bytes(hw_params));
 }
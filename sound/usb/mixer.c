@@ -298,9 +298,10 @@ static int get_ctl_value_v1(struct usb_mixer_elem_info *cval, int request, int v
 		if (chip->shutdown)
 			break;
 		idx = snd_usb_ctrl_intf(chip) | (cval->id << 8);
-		if (snd_usb_ctl_msg(chip->dev, usb_rcvctrlpipe(chip->dev, 0), request,
-				    USB_RECIP_INTERFACE | USB_TYPE_CLASS | USB_DIR_IN,
-				    validx, idx, buf, val_len) >= val_len) {
+		if (snd_usb_ctl_msg_prio(chip, SND_USB_CTL_PRIO_READ,
+					 usb_rcvctrlpipe(chip->dev, 0), request,
+					 USB_RECIP_INTERFACE | USB_TYPE_CLASS | USB_DIR_IN,
+					 validx, idx, buf, val_len) >= val_len) {
 			*value_ret = convert_signed_value(cval, snd_usb_combine_bytes(buf, val_len));
 			err = 0;
 			goto out;
@@ -343,7 +344,8 @@ static int get_ctl_value_v2(struct usb_mixer_elem_info *cval, int request, int v
 		ret = -ENODEV;
 	else {
 		idx = snd_usb_ctrl_intf(chip) | (cval->id << 8);
-		ret = snd_usb_ctl_msg(chip->dev, usb_rcvctrlpipe(chip->dev, 0), bRequest,
+		ret = snd_usb_ctl_msg_prio(chip, SND_USB_CTL_PRIO_READ,
+					   usb_rcvctrlpipe(chip->dev, 0), bRequest,
 			      USB_RECIP_INTERFACE | USB_TYPE_CLASS | USB_DIR_IN,
 			      validx, idx, buf, size);
 	}
@@ -463,10 +465,10 @@ int snd_usb_mixer_set_ctl_value(struct usb_mixer_elem_info *cval,
 		if (chip->shutdown)
 			break;
 		idx = snd_usb_ctrl_intf(chip) | (cval->id << 8);
-		if (snd_usb_ctl_msg(chip->dev,
-				    usb_sndctrlpipe(chip->dev, 0), request,
-				    USB_RECIP_INTERFACE | USB_TYPE_CLASS | USB_DIR_OUT,
-				    validx, idx, buf, val_len) >= 0) {
+		if (snd_usb_ctl_msg_prio(chip, SND_USB_CTL_PRIO_WRITE,
+					 usb_sndctrlpipe(chip->dev, 0), request,
+					 USB_RECIP_INTERFACE | USB_TYPE_CLASS | USB_DIR_OUT,
+					 validx, idx, buf, val_len) >= 0) {
 			err = 0;
 			goto out;
 		}
@@ -1309,6 +1311,8 @@ static void build_feature_ctl(struct mixer_build *state, void *raw_desc,
 
 	snd_printdd(KERN_INFO "[%d] FU [%s] ch = %d, val = %d/%d/%d\n",
 		    cval->id, kctl->id.name, cval->channels, cval->min, cval->max, cval->res);
+	/* let the core serve reads of unchanged values without bus I/O */
+	snd_ctl_shadow_init(kctl, sizeof(long) * MAX_CHANNELS);
 	snd_usb_mixer_add_control(state->mixer, kctl);
 }
 
@@ -2151,13 +2155,22 @@ static int snd_usb_mixer_controls(struct usb_mixer_interface *mixer)
 	return 0;
 }
 
+/* drop the core's copy of the values before reporting a device change */
+static void snd_usb_mixer_shadow_invalidate(struct usb_mixer_elem_info *info)
+{
+	snd_ctl_shadow_invalidate(container_of(info->elem_id,
+					       struct snd_kcontrol, id));
+}
+
 void snd_usb_mixer_notify_id(struct usb_mixer_interface *mixer, int unitid)
 {
 	struct usb_mixer_elem_info *info;
 
-	for (info = mixer->id_elems[unitid]; info; info = info->next_id_elem)
+	for (info = mixer->id_elems[unitid]; info; info = info->next_id_elem) {
+		snd_usb_mixer_shadow_invalidate(info);
 		snd_ctl_notify(mixer->chip->card, SNDRV_CTL_EVENT_MASK_VALUE,
 			       info->elem_id);
+	}
 }
 
 static void snd_usb_mixer_dump_cval(struct snd_info_buffer *buffer,
@@ -2226,6 +2239,7 @@ snd_printk(KERN_INFO "scarlett thobi mixer interrupt %x %x %x\n", attribute, val
 				info->cached &= ~(1 << channel);
 			else /* master channel */
 				info->cached = 0;
+			snd_usb_mixer_shadow_invalidate(info);
 
 			snd_ctl_notify(mixer->chip->card, SNDRV_CTL_EVENT_MASK_VALUE,
 					info->elem_id);
@@ -2307,9 +2321,39 @@ void snd_usb_mixer_inactivate(struct usb_mixer_interface *mixer)
 	usb_kill_urb(mixer->rc_urb);
 }
 
-int snd_usb_mixer_activate(struct usb_mixer_interface *mixer)
+/* write back the cached values of a control after the device lost its state */
+static void restore_mixer_value(struct usb_mixer_elem_info *cval)
 {
-	int err;
+	int c, idx;
+
+	if (cval->cmask) {
+		idx = 0;
+		for (c = 0; c < MAX_CHANNELS; c++) {
+			if (!(cval->cmask & (1 << c)))
+				continue;
+			if (cval->cached & (1 << (c + 1)))
+				set_cur_mix_value(cval, c + 1, idx,
+						  cval->cache_val[idx]);
+			idx++;
+		}
+	} else {
+		/* master */
+		if (cval->cached & 1)
+			set_cur_mix_value(cval, 0, 0, cval->cache_val[0]);
+	}
+}
+
+int snd_usb_mixer_activate(struct usb_mixer_interface *mixer, bool restore)
+{
+	struct usb_mixer_elem_info *cval;
+	int id, err;
+
+	if (restore) {
+		for (id = 0; id < MAX_ID_ELEMS; id++)
+			for (cval = mixer->id_elems[id]; cval;
+			     cval = cval->next_id_elem)
+				restore_mixer_value(cval);
+	}
 
 	if (mixer->urb) {
 		err = usb_submit_urb(mixer->urb, GFP_NOIO);
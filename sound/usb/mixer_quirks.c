@@ -306,18 +306,18 @@ static int snd_audigy2nx_led_put(struct snd_kcontrol *kcontrol, struct snd_ctl_e
 		goto out;
 	}
 	if (mixer->chip->usb_id == USB_ID(0x041e, 0x3042))
-		err = snd_usb_ctl_msg(mixer->chip->dev,
+		err = snd_usb_ctl_msg_prio(mixer->chip, SND_USB_CTL_PRIO_WRITE,
 			      usb_sndctrlpipe(mixer->chip->dev, 0), 0x24,
 			      USB_DIR_OUT | USB_TYPE_VENDOR | USB_RECIP_OTHER,
 			      !value, 0, NULL, 0);
 	/* USB X-Fi S51 Pro */
 	if (mixer->chip->usb_id == USB_ID(0x041e, 0x30df))
-		err = snd_usb_ctl_msg(mixer->chip->dev,
+		err = snd_usb_ctl_msg_prio(mixer->chip, SND_USB_CTL_PRIO_WRITE,
 			      usb_sndctrlpipe(mixer->chip->dev, 0), 0x24,
 			      USB_DIR_OUT | USB_TYPE_VENDOR | USB_RECIP_OTHER,
 			      !value, 0, NULL, 0);
 	else
-		err = snd_usb_ctl_msg(mixer->chip->dev,
+		err = snd_usb_ctl_msg_prio(mixer->chip, SND_USB_CTL_PRIO_WRITE,
 			      usb_sndctrlpipe(mixer->chip->dev, 0), 0x24,
 			      USB_DIR_OUT | USB_TYPE_VENDOR | USB_RECIP_OTHER,
 			      value, index + 2, NULL, 0);
@@ -420,7 +420,7 @@ static void snd_audigy2nx_proc_read(struct snd_info_entry *entry,
 		if (mixer->chip->shutdown)
 			err = 0;
 		else
-			err = snd_usb_ctl_msg(mixer->chip->dev,
+			err = snd_usb_ctl_msg_prio(mixer->chip, SND_USB_CTL_PRIO_READ,
 				      usb_rcvctrlpipe(mixer->chip->dev, 0),
 				      UAC_GET_MEM, USB_DIR_IN | USB_TYPE_CLASS |
 				      USB_RECIP_INTERFACE, 0,
@@ -461,7 +461,7 @@ static int snd_xonar_u1_switch_put(struct snd_kcontrol *kcontrol,
 	if (mixer->chip->shutdown)
 		err = -ENODEV;
 	else
-		err = snd_usb_ctl_msg(mixer->chip->dev,
+		err = snd_usb_ctl_msg_prio(mixer->chip, SND_USB_CTL_PRIO_WRITE,
 			      usb_sndctrlpipe(mixer->chip->dev, 0), 0x08,
 			      USB_DIR_OUT | USB_TYPE_VENDOR | USB_RECIP_OTHER,
 			      50, 0, &new_status, 1);
@@ -711,7 +711,7 @@ static int snd_ftu_eff_switch_get(struct snd_kcontrol *kctl,
 	if (mixer->chip->shutdown)
 		err = -ENODEV;
 	else
-		err = snd_usb_ctl_msg(chip->dev,
+		err = snd_usb_ctl_msg_prio(chip, SND_USB_CTL_PRIO_READ,
 			usb_rcvctrlpipe(chip->dev, 0), UAC_GET_CUR,
 			USB_RECIP_INTERFACE | USB_TYPE_CLASS | USB_DIR_IN,
 			validx << 8, snd_usb_ctrl_intf(chip) | (id << 8),
@@ -764,7 +764,7 @@ static int snd_ftu_eff_switch_put(struct snd_kcontrol *kctl,
 		if (mixer->chip->shutdown)
 			err = -ENODEV;
 		else
-			err = snd_usb_ctl_msg(chip->dev,
+			err = snd_usb_ctl_msg_prio(chip, SND_USB_CTL_PRIO_READ,
 				usb_rcvctrlpipe(chip->dev, 0), UAC_GET_CUR,
 				USB_RECIP_INTERFACE | USB_TYPE_CLASS | USB_DIR_IN,
 				validx << 8, snd_usb_ctrl_intf(chip) | (id << 8),
@@ -785,7 +785,7 @@ static int snd_ftu_eff_switch_put(struct snd_kcontrol *kctl,
 		if (mixer->chip->shutdown)
 			err = -ENODEV;
 		else
-			err = snd_usb_ctl_msg(chip->dev,
+			err = snd_usb_ctl_msg_prio(chip, SND_USB_CTL_PRIO_WRITE,
 				usb_sndctrlpipe(chip->dev, 0), UAC_SET_CUR,
 				USB_RECIP_INTERFACE | USB_TYPE_CLASS | USB_DIR_OUT,
 				validx << 8, snd_usb_ctrl_intf(chip) | (id << 8),
@@ -1368,7 +1368,7 @@ static int snd_microii_spdif_default_get(struct snd_kcontrol *kcontrol,
 	alts = &iface->altsetting[1];
 	ep = get_endpoint(alts, 0)->bEndpointAddress;
 
-	err = snd_usb_ctl_msg(mixer->chip->dev,
+	err = snd_usb_ctl_msg_prio(mixer->chip, SND_USB_CTL_PRIO_READ,
 			usb_rcvctrlpipe(mixer->chip->dev, 0),
 			UAC_GET_CUR,
 			USB_TYPE_CLASS | USB_RECIP_ENDPOINT | USB_DIR_IN,
@@ -1398,7 +1398,7 @@ static int snd_microii_spdif_default_put(struct snd_kcontrol *kcontrol,
 
 	reg = ((ucontrol->value.iec958.status[1] & 0x0f) << 4) |
 			(ucontrol->value.iec958.status[0] & 0x0f);
-	err = snd_usb_ctl_msg(mixer->chip->dev,
+	err = snd_usb_ctl_msg_prio(mixer->chip, SND_USB_CTL_PRIO_WRITE,
 			usb_sndctrlpipe(mixer->chip->dev, 0),
 			UAC_SET_CUR,
 			USB_DIR_OUT | USB_TYPE_VENDOR | USB_RECIP_OTHER,
@@ -1416,7 +1416,7 @@ static int snd_microii_spdif_default_put(struct snd_kcontrol *kcontrol,
 	reg = (ucontrol->value.iec958.status[0] & IEC958_AES0_NONAUDIO) ?
 			0xa0 : 0x20;
 	reg |= (ucontrol->value.iec958.status[1] >> 4) & 0x0f;
-	err = snd_usb_ctl_msg(mixer->chip->dev,
+	err = snd_usb_ctl_msg_prio(mixer->chip, SND_USB_CTL_PRIO_WRITE,
 			usb_sndctrlpipe(mixer->chip->dev, 0),
 			UAC_SET_CUR,
 			USB_DIR_OUT | USB_TYPE_VENDOR | USB_RECIP_OTHER,
@@ -1465,7 +1465,7 @@ static int snd_microii_spdif_switch_put(struct snd_kcontrol *kcontrol,
 	int err;
 	u8 reg = ucontrol->value.integer.value[0] ? 0x28 : 0x2a;
 
-	err = snd_usb_ctl_msg(mixer->chip->dev,
+	err = snd_usb_ctl_msg_prio(mixer->chip, SND_USB_CTL_PRIO_WRITE,
 			usb_sndctrlpipe(mixer->chip->dev, 0),
 			UAC_SET_CUR,
 			USB_DIR_OUT | USB_TYPE_VENDOR | USB_RECIP_OTHER,
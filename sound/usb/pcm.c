@@ -162,10 +162,11 @@ static int init_pitch_v1(struct snd_usb_audio *chip, int iface,
 	ep = get_endpoint(alts, 0)->bEndpointAddress;
 
 	data[0] = 1;
-	if ((err = snd_usb_ctl_msg(dev, usb_sndctrlpipe(dev, 0), UAC_SET_CUR,
-				   USB_TYPE_CLASS|USB_RECIP_ENDPOINT|USB_DIR_OUT,
-				   UAC_EP_CS_ATTR_PITCH_CONTROL << 8, ep,
-				   data, sizeof(data))) < 0) {
+	if ((err = snd_usb_ctl_msg_prio(chip, SND_USB_CTL_PRIO_STREAM,
+					usb_sndctrlpipe(dev, 0), UAC_SET_CUR,
+					USB_TYPE_CLASS|USB_RECIP_ENDPOINT|USB_DIR_OUT,
+					UAC_EP_CS_ATTR_PITCH_CONTROL << 8, ep,
+					data, sizeof(data))) < 0) {
 		snd_printk(KERN_ERR "%d:%d:%d: cannot set enable PITCH\n",
 			   dev->devnum, iface, ep);
 		return err;
@@ -183,10 +184,11 @@ static int init_pitch_v2(struct snd_usb_audio *chip, int iface,
 	int err;
 
 	data[0] = 1;
-	if ((err = snd_usb_ctl_msg(dev, usb_sndctrlpipe(dev, 0), UAC2_CS_CUR,
-				   USB_TYPE_CLASS | USB_RECIP_ENDPOINT | USB_DIR_OUT,
-				   UAC2_EP_CS_PITCH << 8, 0,
-				   data, sizeof(data))) < 0) {
+	if ((err = snd_usb_ctl_msg_prio(chip, SND_USB_CTL_PRIO_STREAM,
+					usb_sndctrlpipe(dev, 0), UAC2_CS_CUR,
+					USB_TYPE_CLASS | USB_RECIP_ENDPOINT | USB_DIR_OUT,
+					UAC2_EP_CS_PITCH << 8, 0,
+					data, sizeof(data))) < 0) {
 		snd_printk(KERN_ERR "%d:%d:%d: cannot set enable PITCH (v2)\n",
 			   dev->devnum, iface, fmt->altsetting);
 		return err;
@@ -703,6 +705,31 @@ static int snd_usb_hw_free(struct snd_pcm_substream *substream)
 	return snd_pcm_lib_free_vmalloc_buffer(substream);
 }
 
+/*
+ * aggregate mode: let the feedback endpoint of another card on the same bus
+ * drive the packet sizes of our playback data endpoint.  the master card
+ * must already be streaming; otherwise we run with our own feedback.
+ * the link survives restarts of the master, and we use our own feedback
+ * only while it is stopped.
+ */
+static void link_aggregate_master(struct snd_usb_substream *subs)
+{
+	struct snd_usb_audio *chip = subs->stream->chip;
+	int err;
+
+	if (chip->aggregate < 0)
+		return;
+
+	err = snd_usb_link_aggregate_master(chip, subs->data_endpoint);
+	if (err == -ENODEV)
+		snd_printk(KERN_WARNING "%d: aggregate master card %d is not streaming\n",
+			   chip->card->number, chip->aggregate);
+	else if (err < 0)
+		snd_printk(KERN_WARNING "%d: cannot slave EP #%x to card %d (%d)\n",
+			   chip->card->number, subs->data_endpoint->ep_num,
+			   chip->aggregate, err);
+}
+
 /*
  * prepare callback
  *
@@ -734,6 +761,9 @@ static int snd_usb_pcm_prepare(struct snd_pcm_substream *substream)
 	snd_usb_endpoint_sync_pending_stop(subs->sync_endpoint);
 	snd_usb_endpoint_sync_pending_stop(subs->data_endpoint);
 
+	if (runtime->status->state == SNDRV_PCM_STATE_XRUN)
+		subs->stat_xruns++;
+
 	ret = set_format(subs, subs->cur_audiofmt);
 	if (ret < 0)
 		goto unlock;
@@ -768,6 +798,10 @@ static int snd_usb_pcm_prepare(struct snd_pcm_substream *substream)
 	subs->last_frame_number = 0;
 	runtime->delay = 0;
 
+	/* slave the playback to the feedback of another card, if requested */
+	if (subs->direction == SNDRV_PCM_STREAM_PLAYBACK)
+		link_aggregate_master(subs);
+
 	/* for playback, submit the URBs now; otherwise, the first hwptr_done
 	 * updates for all URBs would happen at the same time when starting */
 	if (subs->direction == SNDRV_PCM_STREAM_PLAYBACK)
@@ -778,6 +812,91 @@ static int snd_usb_pcm_prepare(struct snd_pcm_substream *substream)
 	return ret;
 }
 
+/*
+ * fast resume: restore the interface, sample rate and endpoint setup of a
+ * substream that was suspended while running, from the state cached at
+ * hw_params/prepare time.  playback endpoints are restarted right away
+ * (sending silence until the RESUME trigger), capture endpoints are
+ * started by the RESUME trigger.
+ */
+static int resume_substream(struct snd_usb_substream *subs)
+{
+	struct snd_pcm_substream *substream = subs->pcm_substream;
+	struct snd_pcm_runtime *runtime;
+	struct audioformat *fmt = subs->cur_audiofmt;
+	struct usb_host_interface *alts;
+	struct usb_interface *iface;
+	int err;
+
+	if (!substream || !fmt || !subs->data_endpoint)
+		return 0;
+	runtime = substream->runtime;
+	if (runtime->status->state != SNDRV_PCM_STATE_SUSPENDED)
+		return 0;
+
+	iface = usb_ifnum_to_if(subs->dev, fmt->iface);
+	if (!iface)
+		return -EINVAL;
+	alts = &iface->altsetting[fmt->altset_idx];
+
+	err = usb_set_interface(subs->dev, fmt->iface, fmt->altsetting);
+	if (err < 0) {
+		snd_printk(KERN_ERR "%d:%d:%d: resume: usb_set_interface failed (%d)\n",
+			   subs->dev->devnum, fmt->iface, fmt->altsetting, err);
+		return -EIO;
+	}
+	snd_usb_set_interface_quirk(subs->dev);
+
+	err = snd_usb_init_pitch(subs->stream->chip, fmt->iface, alts, fmt);
+	if (err < 0)
+		return err;
+	err = snd_usb_init_sample_rate(subs->stream->chip, fmt->iface, alts,
+				       fmt, subs->cur_rate);
+	if (err < 0)
+		return err;
+
+	err = configure_endpoint(subs);
+	if (err < 0)
+		return err;
+	subs->need_setup_ep = false;
+
+	subs->data_endpoint->maxframesize =
+		bytes_to_frames(runtime, subs->data_endpoint->maxpacksize);
+	subs->data_endpoint->curframesize =
+		bytes_to_frames(runtime, subs->data_endpoint->curpacksize);
+
+	subs->last_delay = 0;
+	subs->last_frame_number = 0;
+	runtime->delay = 0;
+
+	if (subs->direction == SNDRV_PCM_STREAM_PLAYBACK) {
+		link_aggregate_master(subs);
+		err = start_endpoints(subs, true);
+	}
+	return err;
+}
+
+/*
+ * re-arm the substreams of a stream after a system resume;
+ * the PCM core then only has to issue the RESUME trigger
+ */
+void snd_usb_pcm_resume(struct snd_usb_stream *as)
+{
+	struct snd_usb_audio *chip = as->chip;
+	int i, err;
+
+	down_read(&chip->shutdown_rwsem);
+	for (i = 0; i < 2 && !chip->shutdown; i++) {
+		err = resume_substream(&as->substream[i]);
+		if (err < 0)
+			snd_printk(KERN_WARNING "%d: fast resume of %s stream failed (%d)\n",
+				   chip->card->number,
+				   i == SNDRV_PCM_STREAM_PLAYBACK ?
+				   "playback" : "capture", err);
+	}
+	up_read(&chip->shutdown_rwsem);
+}
+
 static struct snd_pcm_hardware snd_usb_hardware =
 {
 	.info =			SNDRV_PCM_INFO_MMAP |
@@ -1157,8 +1276,11 @@ static int snd_usb_pcm_open(struct snd_pcm_substream *substream, int direction)
 	subs->interface = -1;
 	subs->altset_idx = 0;
 	runtime->hw = snd_usb_hardware;
+	if (as->chip->fast_resume)
+		runtime->hw.info |= SNDRV_PCM_INFO_RESUME;
 	runtime->private_data = subs;
 	subs->pcm_substream = substream;
+	subs->stat_xruns = 0;
 	/* runtime PM is also done there */
 
 	/* initialize DSD/DOP context */
@@ -1500,6 +1622,11 @@ static int snd_usb_substream_playback_trigger(struct snd_pcm_substream *substrea
 	struct snd_usb_substream *subs = substream->runtime->private_data;
 
 	switch (cmd) {
+	case SNDRV_PCM_TRIGGER_RESUME:
+		/* the endpoints have been restarted by snd_usb_pcm_resume() */
+		if (!test_bit(SUBSTREAM_FLAG_DATA_EP_STARTED, &subs->flags))
+			return -EBADFD;
+		/* fall through */
 	case SNDRV_PCM_TRIGGER_START:
 	case SNDRV_PCM_TRIGGER_PAUSE_RELEASE:
 		subs->data_endpoint->prepare_data_urb = prepare_playback_urb;
@@ -1507,6 +1634,7 @@ static int snd_usb_substream_playback_trigger(struct snd_pcm_substream *substrea
 		subs->running = 1;
 		return 0;
 	case SNDRV_PCM_TRIGGER_STOP:
+	case SNDRV_PCM_TRIGGER_SUSPEND:
 		stop_endpoints(subs, false);
 		subs->running = 0;
 		return 0;
@@ -1528,6 +1656,10 @@ static int snd_usb_substream_capture_trigger(struct snd_pcm_substream *substream
 	struct snd_usb_substream *subs = substream->runtime->private_data;
 
 	switch (cmd) {
+	case SNDRV_PCM_TRIGGER_RESUME:
+		if (subs->need_setup_ep)
+			return -EBADFD;
+		/* fall through */
 	case SNDRV_PCM_TRIGGER_START:
 		err = start_endpoints(subs, false);
 		if (err < 0)
@@ -1537,6 +1669,7 @@ static int snd_usb_substream_capture_trigger(struct snd_pcm_substream *substream
 		subs->running = 1;
 		return 0;
 	case SNDRV_PCM_TRIGGER_STOP:
+	case SNDRV_PCM_TRIGGER_SUSPEND:
 		stop_endpoints(subs, false);
 		subs->running = 0;
 		return 0;
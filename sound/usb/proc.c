@@ -16,6 +16,8 @@
  */
 
 #include <linux/init.h>
+#include <linux/jiffies.h>
+#include <linux/math64.h>
 #include <linux/usb.h>
 
 #include <sound/core.h>
@@ -59,6 +61,29 @@ static void proc_audio_usbid_read(struct snd_info_entry *entry, struct snd_info_
 			    USB_ID_PRODUCT(chip->usb_id));
 }
 
+static void proc_audio_usbctl_read(struct snd_info_entry *entry, struct snd_info_buffer *buffer)
+{
+	static const char * const names[SND_USB_CTL_NUM_PRIOS] = {
+		"stream", "write", "read", "poll"
+	};
+	struct snd_usb_audio *chip = entry->private_data;
+	struct snd_usb_ctl_stats stats;
+	int i;
+
+	snd_iprintf(buffer, "Poll interval: %u ms\n", chip->ctl_poll_interval);
+	for (i = 0; i < SND_USB_CTL_NUM_PRIOS; i++) {
+		spin_lock_irq(&chip->ctl_lock);
+		stats = chip->ctl_stats[i];
+		spin_unlock_irq(&chip->ctl_lock);
+		if (stats.count)
+			stats.total_ns = div_u64(stats.total_ns, stats.count);
+		snd_iprintf(buffer, "%-6s: %u requests, avg %llu us, max %llu us\n",
+			    names[i], stats.count,
+			    div_u64(stats.total_ns, 1000),
+			    div_u64(stats.max_ns, 1000));
+	}
+}
+
 void snd_usb_audio_create_proc(struct snd_usb_audio *chip)
 {
 	struct snd_info_entry *entry;
@@ -66,6 +91,8 @@ void snd_usb_audio_create_proc(struct snd_usb_audio *chip)
 		snd_info_set_text_ops(entry, chip, proc_audio_usbbus_read);
 	if (!snd_card_proc_new(chip->card, "usbid", &entry))
 		snd_info_set_text_ops(entry, chip, proc_audio_usbid_read);
+	if (!snd_card_proc_new(chip->card, "usbctl", &entry))
+		snd_info_set_text_ops(entry, chip, proc_audio_usbctl_read);
 }
 
 /*
@@ -115,6 +142,20 @@ static void proc_dump_substream_formats(struct snd_usb_substream *subs, struct s
 	}
 }
 
+static void proc_dump_ep_stats(const char *name,
+			       struct snd_usb_endpoint *ep,
+			       struct snd_info_buffer *buffer)
+{
+	unsigned int msecs = jiffies_to_msecs(jiffies - ep->stat_start);
+
+	snd_iprintf(buffer, "    %s EP %#x: %u URBs, %u packet errors, %u submit errors\n",
+		    name, ep->ep_num, ep->stat_urbs, ep->stat_packet_errors,
+		    ep->stat_submit_errors);
+	snd_iprintf(buffer, "      Completion time = %llu us/s (max %u us)\n",
+		    msecs ? div_u64(ep->stat_complete_ns, msecs) : 0ULL,
+		    ep->stat_complete_max_ns / 1000);
+}
+
 static void proc_dump_ep_status(struct snd_usb_substream *subs,
 				struct snd_usb_endpoint *data_ep,
 				struct snd_usb_endpoint *sync_ep,
@@ -133,6 +174,9 @@ static void proc_dump_ep_status(struct snd_usb_substream *subs,
 		snd_iprintf(buffer, "    Feedback Format = %d.%d\n",
 			    (sync_ep->syncmaxsize > 3 ? 32 : 24) - res, res);
 	}
+	proc_dump_ep_stats("Data", data_ep, buffer);
+	if (sync_ep)
+		proc_dump_ep_stats("Sync", sync_ep, buffer);
 }
 
 static void proc_dump_substream_status(struct snd_usb_substream *subs, struct snd_info_buffer *buffer)
@@ -145,6 +189,8 @@ static void proc_dump_substream_status(struct snd_usb_substream *subs, struct sn
 	} else {
 		snd_iprintf(buffer, "  Status: Stop\n");
 	}
+	if (subs->pcm_substream)
+		snd_iprintf(buffer, "    Xruns = %u\n", subs->stat_xruns);
 }
 
 static void proc_pcm_format_read(struct snd_info_entry *entry, struct snd_info_buffer *buffer)
@@ -236,11 +236,13 @@ static int get_ctl_urb2(struct snd_usb_audio *chip,
 		ret = -ENODEV;
 	} else {
 		idx = snd_usb_ctrl_intf(chip) | (index << 8);
-		ret = snd_usb_ctl_msg(chip->dev,
-		                      usb_rcvctrlpipe(chip->dev, 0),
-		                      bRequest,
-		                      USB_RECIP_INTERFACE | USB_TYPE_CLASS | USB_DIR_IN,
-		                      wValue, idx, buf, size);
+		/* only the meters (read from memory) are rate limited */
+		ret = snd_usb_ctl_msg_prio(chip, bRequest == UAC2_CS_MEM ?
+		                           SND_USB_CTL_PRIO_POLL : SND_USB_CTL_PRIO_READ,
+		                           usb_rcvctrlpipe(chip->dev, 0),
+		                           bRequest,
+		                           USB_RECIP_INTERFACE | USB_TYPE_CLASS | USB_DIR_IN,
+		                           wValue, idx, buf, size);
 	}
 	up_read(&chip->shutdown_rwsem);
 	snd_usb_autosuspend(chip);
@@ -272,10 +274,10 @@ static int set_ctl_urb2(struct snd_usb_audio *chip,
 		if (chip->shutdown)
 			break;
 		idx = snd_usb_ctrl_intf(chip) | (index << 8);
-		if (snd_usb_ctl_msg(chip->dev,
-				    usb_sndctrlpipe(chip->dev, 0), request,
-				    USB_RECIP_INTERFACE | USB_TYPE_CLASS | USB_DIR_OUT,
-				    wValue, idx, buf, val_len) >= 0) {
+		if (snd_usb_ctl_msg_prio(chip, SND_USB_CTL_PRIO_WRITE,
+					 usb_sndctrlpipe(chip->dev, 0), request,
+					 USB_RECIP_INTERFACE | USB_TYPE_CLASS | USB_DIR_OUT,
+					 wValue, idx, buf, val_len) >= 0) {
 			err = 0;
 			goto out;
 		}
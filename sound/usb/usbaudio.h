@@ -26,6 +26,21 @@
 #define USB_ID_VENDOR(id) ((id) >> 16)
 #define USB_ID_PRODUCT(id) ((u16)(id))
 
+/* priority classes of control requests, highest first */
+enum {
+	SND_USB_CTL_PRIO_STREAM,	/* stream setup: clock, rate, pitch */
+	SND_USB_CTL_PRIO_WRITE,		/* control writes from user space */
+	SND_USB_CTL_PRIO_READ,		/* control reads */
+	SND_USB_CTL_PRIO_POLL,		/* meter polling, rate limited */
+	SND_USB_CTL_NUM_PRIOS
+};
+
+struct snd_usb_ctl_stats {
+	unsigned int count;		/* completed requests */
+	u64 total_ns;			/* total latency incl. queueing */
+	u64 max_ns;			/* worst latency */
+};
+
 /*
  *
  */
@@ -42,6 +57,9 @@ struct snd_usb_audio {
 	unsigned int probing:1;
 	unsigned int autosuspended:1;	
 	unsigned int txfr_quirk:1; /* Subframe boundaries on transfers */
+	/* inside the resume callback; not a bitfield, as it is written
+	 * without shutdown_rwsem */
+	bool in_pm;
 	
 	int num_interfaces;
 	int num_suspended_intf;
@@ -57,6 +75,18 @@ struct snd_usb_audio {
 	int setup;			/* from the 'device_setup' module param */
 	int nrpacks;			/* from the 'nrpacks' module param */
 	bool autoclock;			/* from the 'autoclock' module param */
+	bool fast_resume;		/* from the 'fast_resume' module param */
+	int aggregate;			/* from the 'aggregate' module param */
+	unsigned int ctl_poll_interval;	/* from the 'ctl_poll_interval' module param */
+
+	/* control request scheduler, see snd_usb_ctl_msg_prio() */
+	spinlock_t ctl_lock;
+	wait_queue_head_t ctl_wait;
+	bool ctl_busy;			/* a scheduled request is in flight */
+	bool ctl_shutdown;		/* disconnecting, waiters bail out */
+	unsigned int ctl_pending[SND_USB_CTL_NUM_PRIOS];
+	unsigned long ctl_next_poll;	/* jiffies when the next poll may run */
+	struct snd_usb_ctl_stats ctl_stats[SND_USB_CTL_NUM_PRIOS];
 
 	struct usb_host_interface *ctrl_intf;	/* the audio control interface */
 };